@@ -18,6 +18,16 @@
 #define EPOCH_YEAR				1980	// 1-byte dates are offset from this (for FatFS)
 #define MAX_SPRITES				256		// Maximum number of sprites
 #define MAX_BITMAPS				256		// Maximum number of bitmaps
+#define TILE_LAYERS				3		// Number of tile engine layers
+#define TILE_LAYER_ALL			255		// Tile layer number to draw all layers composited together
+#define TILE_LAYER_PROP_BACKGROUND	0	// Tile layer background colour, shown in empty cells and transparent tile pixels
+#define TILE_LAYER_PROP_TRANSPARENT	1	// Pixel value treated as transparent when compositing tile layers
+#define TILE_LAYER_PROP_PRIORITY	2	// Tile layer draw order when compositing, lowest first
+#define TILE_LAYER_DIRTY_MAX		1024	// Changed tiles tracked per layer before the whole layer is rendered again
+#define MAX_FLOOD_FILL_SPANS	16384	// Maximum number of spans on a flood fill's stack, with any more re-seeded later
+#define POLYGON_EDGE_POOL_SIZE	256		// Number of polygon edges reserved up front for path fills
+#define MAX_DIRTY_RECTS			32		// Maximum number of dirty rectangles tracked per screen buffer
+#define MAX_DISPLAY_LIST_ENTRIES	8192	// Maximum number of entries recorded into one display list
 
 // #define VDP_USE_WDT						// Use the esp watchdog timer (experimental)
 
@@ -63,6 +73,7 @@
 #define VDP_READ_COLOUR			0x94	// Read colour
 #define VDP_FONT				0x95	// Font management commands
 #define VDP_AFFINE_TRANSFORM	0x96	// Set affine transform
+#define VDP_SCREEN_READ			0x97	// Read back a region of the screen
 #define VDP_CONTROLKEYS			0x98	// Control keys on/off
 #define VDP_CHECKKEY			0x99	// Request updated keyboard data for a key
 #define VDP_TEMP_PAGED_MODE		0x9A	// Emable temporary paged mode
@@ -101,6 +112,16 @@
 #define PACKET_MOUSE			0x09	// Mouse data
 #define PACKET_ECHO				0x0A	// Echo
 #define PACKET_ECHO_END			0x0B	// Echo end
+#define PACKET_SCREEN_READ		0x17	// Screen region readback data
+
+// Screen region readback formats
+//
+#define SCREEN_READ_LOGICAL		0x00	// Logical colour (palette index) per pixel
+#define SCREEN_READ_RGBA8888	0x01	// RGBA8888 per pixel
+#define SCREEN_READ_RGBA2222	0x02	// RGBA2222 per pixel
+#define SCREEN_READ_CHARS		0x03	// Character per text cell
+#define SCREEN_READ_FORMAT_MASK	0x03	// Bits used for the readback format
+#define SCREEN_READ_TO_BUFFER	0x80	// Write readback data to a buffer rather than sending to MOS
 
 #define AUDIO_CHANNELS			3		// Default number of audio channels
 #define AUDIO_DEFAULT_SAMPLE_RATE	16384	// Default sample rate
@@ -204,6 +225,7 @@
 #define FONT_SET_NAME					3		// Set font name
 #define FONT_CLEAR						4		// Clear a font
 #define FONT_COPY_SYSTEM				5		// Copy system font to a buffer
+#define FONT_FROM_CONTAINER				6		// Load/define a font from a font container in a buffer
 #define FONT_SELECT_BY_NAME				0x10	// Select a font by name
 #define FONT_DEBUG_INFO					0x20	// Get debug info about a font
 // Future commands may include ability to search for fonts based on their info settings
@@ -221,6 +243,14 @@
 #define FONT_INFO_CODEPAGE				10		// Font code page
 
 #define FONT_SELECTFLAG_ADJUSTBASE		0x01	// Adjust font baseline, based on ascent
+#define FONT_SELECTFLAG_SELECT			0x80	// Select a font once loaded from a container
+
+// Font container format
+// Header of "AF", width, height, ascent, flags, container flags, point size
+// followed by the optional tables given in the container flags, and then the glyph data
+#define FONT_CONTAINER_HEADER_SIZE		8
+#define FONT_CONTAINER_WIDTHS			0x01	// Container has a table of 256 glyph widths (variable width font)
+#define FONT_CONTAINER_CHARPTRS			0x02	// Container has a table of 256 32-bit glyph offsets into the glyph data
 
 // Context management commands
 #define CONTEXT_SELECT					0		// Select a context stack
@@ -275,6 +305,11 @@
 #define BUFFERED_MATRIX					0x22	// Create or combine a matrix buffer of arbitrary dimensions
 #define BUFFERED_TRANSFORM_BITMAP		0x28	// Create a new bitmap from an existing one by applying a 2d transform
 #define BUFFERED_TRANSFORM_DATA			0x29	// Transform data using a given matrix
+#define BUFFERED_PLOT					0x2A	// Plot a series of coordinates from a buffer
+#define BUFFERED_RECORD_LIST			0x2B	// Start recording a display list into a buffer
+#define BUFFERED_END_LIST				0x2C	// Stop recording a display list
+#define BUFFERED_REPLAY_LIST			0x2D	// Replay a display list, with an optional offset
+#define BUFFERED_PATCH_LIST				0x2E	// Change the coordinates or colour of a display list entry
 #define BUFFERED_READ_VARIABLE			0x30	// Read a VDP variable value into a buffer
 #define BUFFERED_COMPRESS				0x40	// Compress blocks from multiple buffers into one buffer
 #define BUFFERED_DECOMPRESS				0x41	// Decompress blocks from multiple buffers into one buffer
@@ -400,6 +435,39 @@
 #define TRANSFORM_DATA_BUFFER_ARGS	0x20	// Optional argument values are fetched from buffers
 #define TRANSFORM_DATA_PER_BLOCK	0x40	// Transform data per block
 
+// Buffered plot option flags
+#define PLOT_BUFFER_HAS_COLOUR		0x01	// Each coordinate pair is followed by GCOL mode and colour bytes
+#define PLOT_BUFFER_HAS_OFFSET		0x02	// Has an offset to the data
+#define PLOT_BUFFER_HAS_STRIDE		0x04	// Has an explicit stride (in bytes) between coordinate pairs
+#define PLOT_BUFFER_HAS_LIMIT		0x08	// Has a limited number of coordinate pairs plotted
+#define PLOT_BUFFER_ADVANCED		0x10	// Advanced offsets
+#define PLOT_BUFFER_BATCH			32		// Number of coordinate pairs converted to screen coordinates together
+
+// Display list entry types
+#define DISPLAY_LIST_PLOT			0x01	// PLOT command, x, y
+#define DISPLAY_LIST_COLOUR			0x02	// Text colour
+#define DISPLAY_LIST_GCOL			0x03	// Graphics mode and colour
+#define DISPLAY_LIST_CHAR			0x04	// Print a character
+#define DISPLAY_LIST_BITMAP_SELECT	0x05	// Select bitmap (ID held in x)
+#define DISPLAY_LIST_BITMAP_DRAW	0x06	// Draw current bitmap at x, y
+
+// Display list patch flags
+#define PATCH_LIST_COORDS			0x01	// Replace the entry's x and y
+#define PATCH_LIST_COLOUR			0x02	// Replace the entry's colour
+
+// Sprite batch update records: sprite ID, flags, X; Y; frame
+#define SPRITE_UPDATE_RECORD_SIZE	7
+#define SPRITE_UPDATE_MOVE			0x01	// Move sprite to X, Y
+#define SPRITE_UPDATE_MOVE_BY		0x02	// Move sprite by X, Y
+#define SPRITE_UPDATE_FRAME			0x04	// Set sprite frame
+#define SPRITE_UPDATE_SHOW			0x08	// Show sprite
+#define SPRITE_UPDATE_HIDE			0x10	// Hide sprite
+
+// Sprite collision grid
+#define SPRITE_COLLISION_CELL_SHIFT	6		// Grid cells are 64 pixels square
+#define SPRITE_COLLISION_COLS		16		// Grid columns, with sprites beyond the last column binned in it
+#define SPRITE_COLLISION_ROWS		12		// Grid rows, with sprites beyond the last row binned in it
+
 // Read flag flags
 #define READ_VAR_BIG_ENDIAN			0x01	// read variable value as big-endian (default is little-endian)
 #define READ_VAR_ADVANCED_OFFSETS	0x10	// advanced, 24-bit offsets (16-bit block offset follows if top bit set)
@@ -455,6 +523,15 @@
 #define VDPVAR_FREEPSRAM_LOW		0x0210	// Free PSRAM low bytes
 #define VDPVAR_FREEPSRAM_HIGH		0x0211	// Free PSRAM high bytes
 #define VDPVAR_BUFFERS_USED			0x0212	// Number of buffers used
+#define VDPVAR_CANVAS_SUPPRESSED_LOW	0x0213	// Redundant canvas state changes skipped, low bytes (set to reset)
+#define VDPVAR_CANVAS_SUPPRESSED_HIGH	0x0214	// Redundant canvas state changes skipped, high bytes (set to reset)
+#define VDPVAR_DIRTY_TRACKING		0x0218	// Dirty rectangle tracking in double-buffered modes (0=off, 1=track, 2=track and restore background)
+#define VDPVAR_DIRTY_BACKGROUND		0x0219	// Bitmap ID used to restore dirty rectangles
+#define VDPVAR_DIRTY_RECTS			0x021A	// Number of dirty rectangles recorded on the current back buffer
+#define VDPVAR_DIRTY_MERGES			0x021B	// Dirty rectangles merged because the list was full (set to reset)
+#define VDPVAR_DIRTY_RESTORED		0x021C	// Number of dirty rectangles restored at the last buffer switch
+#define VDPVAR_DIRTY_AREA_LOW		0x021D	// Pixels restored at the last buffer switch, low bytes
+#define VDPVAR_DIRTY_AREA_HIGH		0x021E	// Pixels restored at the last buffer switch, high bytes
 #define VDPVAR_KEYBOARD_LAYOUT		0x0220	// Keyboard layout
 #define VDPVAR_KEYBOARD_CTRL_KEYS	0x0221	// Control keys on/off
 #define VDPVAR_KEYBOARD_REP_DELAY	0x0222	// Keyboard repeat delay (milliseconds)
@@ -503,6 +580,9 @@
 #define TESTFLAG_TILE_ENGINE		0x0300	// Tile engine flag (layers commands)
 #define VDPVAR_COPPER				0x0310	// Copper feature flag
 #define VDPVAR_AUTO_HW_SPRITES		0x0400	// Auto hardware sprites flag
+#define VDPVAR_SPRITE_HITS			0x0410	// Number of collisions found by the last sprite collision test
+#define VDPVAR_SPRITE_HIT_A			0x0411	// First sprite colliding, or first A sprite of a group test (65535 if none)
+#define VDPVAR_SPRITE_HIT_B			0x0412	// First B sprite colliding in a group test (65535 if none)
 #define VDPVAR_LAST_CHARACTER_READ	0x0500	// Last character read from screen
 #define VDPVAR_LAST_COLOUR_RED		0x0510	// Last colour read (red component)
 #define VDPVAR_LAST_COLOUR_GREEN	0x0511	// Last colour read (green component)
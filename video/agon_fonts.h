@@ -36,8 +36,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <fabgl.h>
 
@@ -51,6 +54,38 @@ std::unordered_map<uint16_t, std::shared_ptr<fabgl::FontInfo>,
 
 uint8_t FONT_AGON_DATA[256*8]; 
 
+// Font holding storage built for it, which lives as long as the font does
+//
+struct AgonFont : fabgl::FontInfo {
+	std::unique_ptr<uint32_t[]>							charPtrs;	// Character pointers built for a variable width font
+	std::vector<uint8_t, psram_allocator<uint8_t>>		glyphData;	// Glyph data unpacked from a font container
+};
+
+// Glyph recognition index, used to match characters read back from the screen
+// Glyphs of the font in use are hashed into an open-addressed table, which is built on demand
+// and rebuilt whenever a different font is used or font data is redefined
+//
+#define GLYPH_INDEX_SIZE		512		// Must be a power of 2, and at least double the number of glyphs
+
+struct GlyphIndexEntry {
+	uint32_t	hash;
+	uint16_t	c;						// Character code, or 65535 for an empty slot
+};
+
+GlyphIndexEntry			glyphIndex[GLYPH_INDEX_SIZE];
+fabgl::FontInfo *		glyphIndexFont = nullptr;	// Font the glyph index was built for (nullptr for system font)
+bool					glyphIndexValid = false;
+
+// Advance widths of the variable width font last measured, so laying out text doesn't need to walk glyph data
+const fabgl::FontInfo *	advanceFont = nullptr;
+uint8_t					advanceWidths[256];
+
+// Called whenever font data changes, so cached advances are also discarded
+inline void invalidateGlyphIndex() {
+	glyphIndexValid = false;
+	advanceFont = nullptr;
+}
+
 static const uint8_t FONT_AGON_BITMAP[] = {
 	0x00, 0x3c, 0x66, 0x42, 0x42, 0x66, 0x3c, 0x00, // NUL 25CB White Circle
 	0x00, 0x00, 0x3c, 0x3c, 0x3c, 0x3c, 0x00, 0x00, // SOH 25A0 Black Square
@@ -335,6 +370,7 @@ const fabgl::FontInfo FONT_AGON = {
 //
 void copy_font() {
 	memcpy(FONT_AGON_DATA, FONT_AGON_BITMAP, sizeof(FONT_AGON_BITMAP));
+	invalidateGlyphIndex();
 }
 
 // Redefine a character in the system font
@@ -342,6 +378,7 @@ void copy_font() {
 //
 void redefineCharacter(uint8_t c, uint8_t * data) {
 	memcpy(&FONT_AGON_DATA[c * 8], data, 8);
+	invalidateGlyphIndex();
 }
 
 std::shared_ptr<fabgl::FontInfo> createFontFromBuffer(uint16_t bufferId, uint8_t width, uint8_t height, uint8_t ascent, uint8_t flags) {
@@ -354,22 +391,46 @@ std::shared_ptr<fabgl::FontInfo> createFontFromBuffer(uint16_t bufferId, uint8_t
 		return nullptr;
 	}
 
+	auto data = buffers[bufferId][0]->getBuffer();
+	auto bufferSize = buffers[bufferId][0]->size();
+	auto font = make_shared_psram<AgonFont>();
+
 	if (~flags & FONTINFOFLAGS_VARWIDTH) {
 		// Font is fixed width, so we can calculate the size that our font data should be
 		auto size = ((width + 7) >> 3) * height * 256;
-		if (buffers[bufferId][0]->size() != size) {
+		if (bufferSize != size) {
 			debug_log("createFontFromBuffer: buffer %d is not the correct size for a fixed width font\n\r", bufferId);
 			return nullptr;
 		}
 	} else {
-		// Variable width fonts not yet supported - will be in the future
-		debug_log("createFontFromBuffer: variable width fonts not yet supported\n\r");
-		return nullptr;
+		// Variable width font data has 256 glyphs back to back, each being a width byte followed by its rows
+		// so we build a table of character pointers, and work out the widest glyph if no width was given
+		font->charPtrs = make_unique_psram_array<uint32_t>(256);
+		if (!font->charPtrs) {
+			debug_log("createFontFromBuffer: failed to allocate character pointers for font %d\n\r", bufferId);
+			return nullptr;
+		}
+		uint32_t offset = 0;
+		uint8_t maxWidth = 0;
+		for (auto c = 0; c < 256; c++) {
+			if (offset >= bufferSize) {
+				debug_log("createFontFromBuffer: buffer %d is too short for a variable width font\n\r", bufferId);
+				return nullptr;
+			}
+			auto glyphWidth = data[offset];
+			font->charPtrs[c] = offset;
+			maxWidth = std::max(maxWidth, glyphWidth);
+			offset += 1 + ((glyphWidth + 7) >> 3) * height;
+		}
+		if (offset != bufferSize) {
+			debug_log("createFontFromBuffer: buffer %d is not the correct size for a variable width font\n\r", bufferId);
+			return nullptr;
+		}
+		if (width == 0) {
+			width = maxWidth;
+		}
 	}
 
-	auto data = buffers[bufferId][0]->getBuffer();
-
-	auto font = make_shared_psram<fabgl::FontInfo>();
 	font->width = width;
 	font->height = height;
 	font->ascent = ascent;
@@ -377,7 +438,7 @@ std::shared_ptr<fabgl::FontInfo> createFontFromBuffer(uint16_t bufferId, uint8_t
 	font->data = data;
 
 	// Fill in default/empty values for the rest of the fields
-	font->chptr = nullptr;
+	font->chptr = font->charPtrs.get();
 	font->pointSize = 0;
 	font->inleading = 0;
 	font->exleading = 0;
@@ -386,6 +447,105 @@ std::shared_ptr<fabgl::FontInfo> createFontFromBuffer(uint16_t bufferId, uint8_t
 	font->codepage = 1252;
 
 	fonts[bufferId] = font;
+	invalidateGlyphIndex();
+
+	return font;
+}
+
+// Create a font from a font container in a buffer
+// The container is validated and unpacked into storage owned by the font before the font
+// replaces any existing one with the same ID, so a bad container leaves fonts untouched
+//
+std::shared_ptr<fabgl::FontInfo> createFontFromContainer(uint16_t bufferId) {
+	if (bufferId == 65535 || (buffers.find(bufferId) == buffers.end())) {
+		debug_log("createFontFromContainer: buffer %d not found\n\r", bufferId);
+		return nullptr;
+	}
+	if (buffers[bufferId].size() != 1) {
+		debug_log("createFontFromContainer: buffer %d is not a singular buffer and cannot be used for a font source\n\r", bufferId);
+		return nullptr;
+	}
+
+	auto source = buffers[bufferId][0]->getBuffer();
+	auto sourceSize = buffers[bufferId][0]->size();
+	if (sourceSize < FONT_CONTAINER_HEADER_SIZE || source[0] != 'A' || source[1] != 'F') {
+		debug_log("createFontFromContainer: buffer %d is not a font container\n\r", bufferId);
+		return nullptr;
+	}
+	uint8_t width = source[2];
+	uint8_t height = source[3];
+	uint8_t containerFlags = source[6];
+
+	uint32_t offset = FONT_CONTAINER_HEADER_SIZE;
+	const uint8_t * widths = nullptr;
+	const uint8_t * charPtrs = nullptr;
+	if (containerFlags & FONT_CONTAINER_WIDTHS) {
+		widths = source + offset;
+		offset += 256;
+	}
+	if (containerFlags & FONT_CONTAINER_CHARPTRS) {
+		charPtrs = source + offset;
+		offset += 256 * 4;
+	}
+	bool variableWidth = widths != nullptr;
+	if (offset > sourceSize || height == 0 || (!variableWidth && width == 0)) {
+		debug_log("createFontFromContainer: buffer %d has an invalid font container header\n\r", bufferId);
+		return nullptr;
+	}
+	auto glyphs = source + offset;
+	uint32_t glyphsSize = sourceSize - offset;
+
+	// Unpack the glyphs in a single pass, variable width glyphs gaining the width byte vdp-gl expects
+	auto font = make_shared_psram<AgonFont>();
+	if (variableWidth) {
+		font->charPtrs = make_unique_psram_array<uint32_t>(256);
+		if (!font->charPtrs) {
+			debug_log("createFontFromContainer: failed to allocate character pointers for font %d\n\r", bufferId);
+			return nullptr;
+		}
+	}
+	font->glyphData.reserve(glyphsSize + (variableWidth ? 256 : 0));
+	uint32_t glyphStart = 0;
+	uint8_t maxWidth = 0;
+	for (auto c = 0; c < 256; c++) {
+		uint8_t glyphWidth = variableWidth ? widths[c] : width;
+		uint32_t glyphSize = ((glyphWidth + 7) >> 3) * height;
+		if (charPtrs) {
+			auto ptr = charPtrs + (c * 4);
+			glyphStart = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+		}
+		if (glyphStart > glyphsSize || glyphSize > glyphsSize - glyphStart) {
+			debug_log("createFontFromContainer: glyph %d is outside the glyph data in buffer %d\n\r", c, bufferId);
+			return nullptr;
+		}
+		if (variableWidth) {
+			font->charPtrs[c] = font->glyphData.size();
+			font->glyphData.push_back(glyphWidth);
+			maxWidth = std::max(maxWidth, glyphWidth);
+		}
+		font->glyphData.insert(font->glyphData.end(), glyphs + glyphStart, glyphs + glyphStart + glyphSize);
+		glyphStart += glyphSize;
+	}
+	if (!charPtrs && glyphStart != glyphsSize) {
+		debug_log("createFontFromContainer: buffer %d has the wrong amount of glyph data\n\r", bufferId);
+		return nullptr;
+	}
+
+	font->width = (variableWidth && width == 0) ? maxWidth : width;
+	font->height = height;
+	font->ascent = source[4];
+	font->flags = variableWidth ? (source[5] | FONTINFOFLAGS_VARWIDTH) : (source[5] & ~FONTINFOFLAGS_VARWIDTH);
+	font->pointSize = source[7];
+	font->data = font->glyphData.data();
+	font->chptr = font->charPtrs.get();
+	font->inleading = 0;
+	font->exleading = 0;
+	font->weight = 400;
+	font->charset = 255;
+	font->codepage = 1252;
+
+	fonts[bufferId] = font;
+	invalidateGlyphIndex();
 
 	return font;
 }
@@ -397,6 +557,7 @@ void setFontInfo(uint16_t bufferId, uint8_t field, uint16_t value) {
 	}
 
 	auto font = fonts[bufferId];
+	invalidateGlyphIndex();
 	switch (field) {
 		case FONT_INFO_WIDTH: {
 			font->width = (uint8_t) value;
@@ -448,10 +609,63 @@ void clearFont(uint16_t bufferId) {
 	}
 
 	fonts.erase(bufferId);
+	invalidateGlyphIndex();
 }
 
 void resetFonts() {
 	fonts.clear();
+	invalidateGlyphIndex();
+}
+
+// Check whether a font lays out text with per-character advances
+//
+inline bool isVariableWidthFont(const fabgl::FontInfo * font) {
+	return (font->flags & FONTINFOFLAGS_VARWIDTH) && font->chptr != nullptr;
+}
+
+// Get the advance width of a character
+//
+uint8_t getCharWidth(const fabgl::FontInfo * font, uint8_t c) {
+	if (!isVariableWidthFont(font)) {
+		return font->width;
+	}
+	if (advanceFont != font) {
+		for (auto i = 0; i < 256; i++) {
+			advanceWidths[i] = font->data[font->chptr[i]];
+		}
+		advanceFont = font;
+	}
+	return advanceWidths[c];
+}
+
+// Get the pixel data for a character, skipping the width byte of variable width glyphs
+//
+inline const uint8_t * getCharGlyph(const fabgl::FontInfo * font, uint8_t c) {
+	if (isVariableWidthFont(font)) {
+		return font->data + font->chptr[c] + 1;
+	}
+	return font->data + (c * font->height * ((font->width + 7) >> 3));
+}
+
+// Measure a string without rendering it
+// If given, prefix is filled with the offset of each character from the start of the string,
+// followed by the total width, so where the string would break can be found from the table
+//
+uint32_t measureText(const fabgl::FontInfo * font, const std::string& s, std::vector<uint32_t> * prefix = nullptr) {
+	uint32_t width = 0;
+	if (prefix) {
+		prefix->resize(s.size() + 1);
+	}
+	for (size_t i = 0; i < s.size(); i++) {
+		if (prefix) {
+			(*prefix)[i] = width;
+		}
+		width += getCharWidth(font, s[i]);
+	}
+	if (prefix) {
+		(*prefix)[s.size()] = width;
+	}
+	return width;
 }
 
 uint8_t * getCharPtr(std::shared_ptr<fabgl::FontInfo> font, uint8_t c) {
@@ -467,3 +681,64 @@ uint8_t * getCharPtr(std::shared_ptr<fabgl::FontInfo> font, uint8_t c) {
 	}
 }
 
+// Hash a glyph bitmap (FNV-1a)
+//
+uint32_t hashGlyph(const uint8_t * data, uint16_t len) {
+	uint32_t hash = 2166136261u;
+	for (uint16_t i = 0; i < len; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// Build the glyph index for a font
+// Characters are added in the same order as a screen character match has always checked them,
+// 32-255 then 0-31, with duplicate glyphs keeping the first character added
+//
+void buildGlyphIndex(std::shared_ptr<fabgl::FontInfo> font) {
+	auto fontPtr = font ? font.get() : &FONT_AGON;
+	uint16_t charSize = ((fontPtr->width + 7) >> 3) * fontPtr->height;
+
+	for (auto &entry : glyphIndex) {
+		entry.c = 65535;
+	}
+	for (auto i = 32; i <= (255 + 31); i++) {
+		uint8_t c = i & 0xFF;
+		auto data = getCharPtr(font, c);
+		auto hash = hashGlyph(data, charSize);
+		auto slot = hash & (GLYPH_INDEX_SIZE - 1);
+		bool duplicate = false;
+		while (glyphIndex[slot].c != 65535) {
+			if (glyphIndex[slot].hash == hash && memcmp(getCharPtr(font, glyphIndex[slot].c), data, charSize) == 0) {
+				duplicate = true;
+				break;
+			}
+			slot = (slot + 1) & (GLYPH_INDEX_SIZE - 1);
+		}
+		if (!duplicate) {
+			glyphIndex[slot].hash = hash;
+			glyphIndex[slot].c = c;
+		}
+	}
+	glyphIndexFont = font.get();
+	glyphIndexValid = true;
+}
+
+// Find the character in a font matching the given glyph bitmap
+// returns the character code, or -1 if there is no match
+//
+int16_t findGlyph(std::shared_ptr<fabgl::FontInfo> font, const uint8_t * data, uint16_t len) {
+	if (!glyphIndexValid || glyphIndexFont != font.get()) {
+		buildGlyphIndex(font);
+	}
+	auto hash = hashGlyph(data, len);
+	auto slot = hash & (GLYPH_INDEX_SIZE - 1);
+	while (glyphIndex[slot].c != 65535) {
+		auto c = glyphIndex[slot].c;
+		if (glyphIndex[slot].hash == hash && memcmp(getCharPtr(font, c), data, len) == 0) {
+			return c;
+		}
+		slot = (slot + 1) & (GLYPH_INDEX_SIZE - 1);
+	}
+	return -1;
+}
@@ -2,6 +2,7 @@
 #define AGON_SCREEN_H
 
 #include <memory>
+#include <unordered_map>
 #include <fabgl.h>
 
 #include "agon.h"								// Agon definitions
@@ -11,6 +12,91 @@
 std::unique_ptr<fabgl::Canvas>	canvas;			// The canvas class
 std::unique_ptr<fabgl::VGABaseController>	_VGAController;		// Pointer to the current VGA controller class
 
+// Shadow of the drawing state last applied to the canvas
+// Every canvas state change queues a primitive for the display controller,
+// so changes that would leave the state as it already is are skipped
+//
+struct CanvasState {
+	RGB888					penColor;
+	RGB888					brushColor;
+	fabgl::PaintOptions		paintOptions;
+	fabgl::LineOptions		lineOptions;
+	Rect					clippingRect;
+	bool					penColorValid = false;
+	bool					brushColorValid = false;
+	bool					paintOptionsValid = false;
+	bool					lineOptionsValid = false;
+	bool					clippingRectValid = false;
+};
+
+CanvasState		canvasState;					// Last known canvas drawing state
+uint32_t		canvasStateSuppressed = 0;		// Count of redundant canvas state changes skipped
+
+// Forget the last known canvas state, so the next change of each item is always applied
+// Needed whenever the canvas is replaced, or its state may have been changed elsewhere
+//
+inline void invalidateCanvasState() {
+	canvasState.penColorValid = false;
+	canvasState.brushColorValid = false;
+	canvasState.paintOptionsValid = false;
+	canvasState.lineOptionsValid = false;
+	canvasState.clippingRectValid = false;
+}
+
+inline void setCanvasPenColor(RGB888 colour) {
+	if (canvasState.penColorValid && canvasState.penColor == colour) {
+		canvasStateSuppressed++;
+		return;
+	}
+	canvas->setPenColor(colour);
+	canvasState.penColor = colour;
+	canvasState.penColorValid = true;
+}
+
+inline void setCanvasBrushColor(RGB888 colour) {
+	if (canvasState.brushColorValid && canvasState.brushColor == colour) {
+		canvasStateSuppressed++;
+		return;
+	}
+	canvas->setBrushColor(colour);
+	canvasState.brushColor = colour;
+	canvasState.brushColorValid = true;
+}
+
+inline void setCanvasPaintOptions(fabgl::PaintOptions options) {
+	// Compare the fields rather than the bytes, as the bitfields leave padding bits undefined
+	auto &current = canvasState.paintOptions;
+	if (canvasState.paintOptionsValid && current.swapFGBG == options.swapFGBG && current.NOT == options.NOT && current.mode == options.mode) {
+		canvasStateSuppressed++;
+		return;
+	}
+	canvas->setPaintOptions(options);
+	canvasState.paintOptions = options;
+	canvasState.paintOptionsValid = true;
+}
+
+inline void setCanvasLineOptions(fabgl::LineOptions options) {
+	auto &current = canvasState.lineOptions;
+	if (canvasState.lineOptionsValid && current.usePattern == options.usePattern && current.omitFirst == options.omitFirst && current.omitLast == options.omitLast) {
+		canvasStateSuppressed++;
+		return;
+	}
+	canvas->setLineOptions(options);
+	canvasState.lineOptions = options;
+	canvasState.lineOptionsValid = true;
+}
+
+inline void setCanvasClippingRect(Rect rect) {
+	auto &current = canvasState.clippingRect;
+	if (canvasState.clippingRectValid && current.X1 == rect.X1 && current.Y1 == rect.Y1 && current.X2 == rect.X2 && current.Y2 == rect.Y2) {
+		canvasStateSuppressed++;
+		return;
+	}
+	canvas->setClippingRect(rect);
+	canvasState.clippingRect = rect;
+	canvasState.clippingRectValid = true;
+}
+
 #include "agon_ttxt.h"
 
 bool			legacyModes = false;			// Default legacy modes being false
@@ -20,10 +106,113 @@ uint16_t		canvasW;						// Canvas width
 uint16_t		canvasH;						// Canvas height
 double			logicalScaleX;					// Scaling factor for logical coordinates
 double			logicalScaleY;
+bool			logicalScaleExactX = false;		// Integer scaling gives identical results to the scaling factors
+bool			logicalScaleExactY = false;
 bool			rectangularPixels = false;		// Pixels are square by default
 uint8_t			videoMode;						// Current video mode
 
 extern void debug_log(const char * format, ...);		// Debug log function
+extern std::shared_ptr<Bitmap> getBitmap(uint16_t id);
+
+// Ask our screen controller if we're double buffered
+//
+inline bool isDoubleBuffered() {
+	return _VGAController->isDoubleBuffered();
+}
+
+// Dirty rectangle tracking for double-buffered modes
+// Each screen buffer keeps a list of the areas drawn to since it was last shown,
+// so that restore mode can repaint just those areas from a background bitmap
+//
+struct DirtyList {
+	Rect			rects[MAX_DIRTY_RECTS];
+	uint8_t			count = 0;
+};
+
+DirtyList		dirtyLists[2];					// Dirty rectangles for each screen buffer
+uint8_t			dirtyBuffer = 0;				// Index of the dirty list for the current back buffer
+uint8_t			dirtyTracking = 0;				// Dirty tracking mode (0 = off, 1 = track, 2 = track and restore)
+uint16_t		dirtyBackground = 65535;		// Bitmap used to restore dirty rectangles
+uint16_t		dirtyMerges = 0;				// Rectangles merged because a list was full
+uint8_t			dirtyRestored = 0;				// Rectangles restored at the last buffer switch
+uint32_t		dirtyRestoredArea = 0;			// Pixels restored at the last buffer switch
+
+inline void clearDirtyRects() {
+	dirtyLists[0].count = 0;
+	dirtyLists[1].count = 0;
+}
+
+void setDirtyTracking(uint8_t mode) {
+	dirtyTracking = mode;
+	clearDirtyRects();
+}
+
+// Record an area of the back buffer as drawn to
+// Rectangles that touch an existing entry are merged into it, and when the list is full
+// the new rectangle is merged with whichever entry grows the least
+//
+void markDirty(Rect rect) {
+	if (!dirtyTracking || !isDoubleBuffered()) {
+		return;
+	}
+	rect = rect.intersection(Rect(0, 0, canvasW - 1, canvasH - 1));
+	if (rect.X1 > rect.X2 || rect.Y1 > rect.Y2) {
+		return;
+	}
+	auto &list = dirtyLists[dirtyBuffer];
+	for (int i = 0; i < list.count; i++) {
+		auto &r = list.rects[i];
+		if (rect.X1 <= r.X2 + 1 && rect.X2 >= r.X1 - 1 && rect.Y1 <= r.Y2 + 1 && rect.Y2 >= r.Y1 - 1) {
+			r = r.merge(rect);
+			return;
+		}
+	}
+	if (list.count < MAX_DIRTY_RECTS) {
+		list.rects[list.count++] = rect;
+		return;
+	}
+	int best = 0;
+	int32_t bestGrowth = INT32_MAX;
+	for (int i = 0; i < list.count; i++) {
+		auto &r = list.rects[i];
+		auto merged = r.merge(rect);
+		int32_t growth = (int32_t)merged.width() * merged.height() - (int32_t)r.width() * r.height();
+		if (growth < bestGrowth) {
+			best = i;
+			bestGrowth = growth;
+		}
+	}
+	list.rects[best] = list.rects[best].merge(rect);
+	dirtyMerges++;
+}
+
+// Repaint the dirty areas of the back buffer from the background bitmap, then clear its list
+// The canvas clipping rectangle and paint options are put back afterwards
+//
+void restoreDirtyRects() {
+	auto &list = dirtyLists[dirtyBuffer];
+	dirtyRestored = 0;
+	dirtyRestoredArea = 0;
+	auto bitmap = getBitmap(dirtyBackground);
+	if (bitmap && list.count) {
+		auto state = canvasState;
+		setCanvasPaintOptions(fabgl::PaintOptions());
+		for (int i = 0; i < list.count; i++) {
+			auto &r = list.rects[i];
+			setCanvasClippingRect(r);
+			canvas->drawBitmap(0, 0, bitmap.get());
+			dirtyRestoredArea += (uint32_t)r.width() * r.height();
+		}
+		dirtyRestored = list.count;
+		if (state.paintOptionsValid) {
+			setCanvasPaintOptions(state.paintOptions);
+		}
+		if (state.clippingRectValid) {
+			setCanvasClippingRect(state.clippingRect);
+		}
+	}
+	list.count = 0;
+}
 
 void setLegacyModes(bool legacy) {
 	legacyModes = legacy;
@@ -204,6 +393,46 @@ bool updateVGAController(uint8_t colours) {
 	return true;
 }
 
+// Check whether scaling between logical and screen sizes with integer maths exactly matches using scaling factors
+// Scaled values only differ where the true result is a whole number and floating point rounding falls just short of it,
+// which can only happen for multiples of the size divided by the greatest common divisor, so only those are checked
+// That is still tens of thousands of double operations, which the ESP32 does in software,
+// so the result is cached for each pair of sizes and changing back to a size already seen costs a lookup
+//
+bool checkExactLogicalScale(int32_t logicalSize, int32_t screenSize) {
+	static std::unordered_map<uint32_t, bool> checked;
+	uint32_t key = (logicalSize << 16) | screenSize;
+	auto cached = checked.find(key);
+	if (cached != checked.end()) {
+		return cached->second;
+	}
+	bool exact = true;
+	int32_t gcd = logicalSize;
+	int32_t remainder = screenSize;
+	while (remainder != 0) {
+		auto next = gcd % remainder;
+		gcd = remainder;
+		remainder = next;
+	}
+	double scale = logicalSize / (double)screenSize;
+	// logical to screen, for all 16-bit values (results are symmetric for negative values)
+	for (int32_t value = logicalSize / gcd; value <= 32768; value += logicalSize / gcd) {
+		if ((int32_t)((double)value / scale) != (value * screenSize) / logicalSize) {
+			exact = false;
+			break;
+		}
+	}
+	// screen to logical, including screen values offset by the height when the Y axis is inverted
+	for (int32_t value = screenSize / gcd; exact && value <= 32768 + screenSize; value += screenSize / gcd) {
+		if ((int32_t)((double)value * scale) != (value * logicalSize) / screenSize) {
+			exact = false;
+			break;
+		}
+	}
+	checked[key] = exact;
+	return exact;
+}
+
 // Change video resolution
 // Parameters:
 // - colours: Number of colours per pixel (2, 4, 8, 16 or 64)
@@ -230,6 +459,8 @@ int8_t changeResolution(uint8_t colours, const char * modeLine, bool doubleBuffe
 	_VGAController->enableBackgroundPrimitiveTimeout(false);
 
 	canvas.reset(new fabgl::Canvas(_VGAController.get()));		// Create the new canvas
+	invalidateCanvasState();
+	clearDirtyRects();
 	debug_log("after change of canvas...\n\r");
 	debug_log("  free internal: %d\n\r  free 8bit: %d\n\r  free 32bit: %d\n\r",
 		heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
@@ -241,6 +472,8 @@ int8_t changeResolution(uint8_t colours, const char * modeLine, bool doubleBuffe
 	canvasH = canvas->getHeight();
 	logicalScaleX = LOGICAL_SCRW / (double)canvasW;
 	logicalScaleY = LOGICAL_SCRH / (double)canvasH;
+	logicalScaleExactX = checkExactLogicalScale(LOGICAL_SCRW, canvasW);
+	logicalScaleExactY = checkExactLogicalScale(LOGICAL_SCRH, canvasH);
 	rectangularPixels = ((float)canvasW / (float)canvasH) > 2;
 
 	//
@@ -456,7 +689,7 @@ int8_t changeMode(uint8_t mode) {
 
 	}
 
-	debug_log("changeMode: canvas(%d,%d), scale(%f,%f), mode %d, videoMode %d\n\r", canvasW, canvasH, logicalScaleX, logicalScaleY, mode, videoMode);
+	debug_log("changeMode: canvas(%d,%d), scale(%f,%f), exact(%d,%d), mode %d, videoMode %d\n\r", canvasW, canvasH, logicalScaleX, logicalScaleY, logicalScaleExactX, logicalScaleExactY, mode, videoMode);
 	if (errVal == 0) {
 		videoMode = mode;
 	}
@@ -466,24 +699,47 @@ int8_t changeMode(uint8_t mode) {
 	return errVal;
 }
 
-// Ask our screen controller if we're double buffered
-//
-inline bool isDoubleBuffered() {
-	return _VGAController->isDoubleBuffered();
-}
-
 // Wait for plot completion
 //
 inline void waitPlotCompletion(bool waitForVSync = false) {
 	canvas->waitCompletion(waitForVSync);
 }
 
+// Read a horizontal run of pixels directly from the screen
+// converting from the current controller's pixel format
+//
+inline void readScreenRow(int16_t x1, int16_t x2, int16_t y, RGB888 * dest) {
+	_VGAController->readScreen(Rect(x1, y, x2, y), dest);
+}
+
+// Read up to 32 pixels from a screen row into a bit mask
+// bit n is set when pixel x1 + n does (or when matching is false, does not) match the given colour
+//
+uint32_t readScreenRowMask(int16_t x1, int16_t x2, int16_t y, RGB888 colour, bool matching) {
+	RGB888 pixels[32];
+	uint32_t mask = 0;
+	readScreenRow(x1, x2, y, pixels);
+	for (int i = 0; i <= x2 - x1; i++) {
+		if ((pixels[i] == colour) == matching) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
 // Swap to other buffer if we're in a double-buffered mode
 // Always waits for VSYNC
+// With dirty tracking the new back buffer's list is reset, restoring its background first if required
 //
 void switchBuffer() {
 	if (isDoubleBuffered()) {
 		canvas->swapBuffers();
+		dirtyBuffer ^= 1;
+		if (dirtyTracking == 2) {
+			restoreDirtyRects();
+		} else {
+			dirtyLists[dirtyBuffer].count = 0;
+		}
 	} else {
 		canvas->noOp();
 		waitPlotCompletion(true);
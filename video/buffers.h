@@ -21,6 +21,17 @@ struct AdvancedOffset {
 	size_t blockIndex = 0;
 };
 
+// Pre-decoded display list entry, as recorded into a buffer
+// Fixed size, so entry N is always at offset N * sizeof(DisplayListEntry)
+struct DisplayListEntry {
+	uint8_t		type;			// DISPLAY_LIST_* entry type
+	uint8_t		command;		// PLOT command, GCOL mode or character
+	uint8_t		colour;			// Colour for COLOUR and GCOL entries
+	uint8_t		reserved;
+	int16_t		x;
+	int16_t		y;
+};
+
 typedef union {
 	struct {
 		uint8_t rows : 4;
@@ -5,6 +5,7 @@
 // This includes all cursor, viewport, and graphics contextual data
 //
 
+#include <deque>
 #include <memory>
 #include <vector>
 
@@ -37,6 +38,23 @@ typedef union {
 	};
 } CursorBehaviour;
 
+// Angle limits for arcs, sectors and segments
+// Vectors are relative to the centre, with y pointing up
+struct ArcLimits {
+	int32_t		startX, startY;				// Start point, on the circle
+	int32_t		endX, endY;					// End point (on the circle for segments, otherwise just a direction)
+	bool		reflex;						// Arc sweeps more than 180 degrees
+	bool		chord;						// Limit to the chord side (segment) rather than the wedge (arc or sector)
+};
+
+// Character to bitmap mapping, along with the bitmaps the mapped IDs resolve to
+// Resolved pointers are refreshed when bitmaps have been created or removed since they were taken
+struct CharBitmapMapping {
+	std::vector<uint16_t>	ids = std::vector<uint16_t>(256, 65535);	// Bitmap ID for each character (65535 for none)
+	Bitmap *				resolved[256];								// Bitmap for each character
+	uint32_t				generation = 0;								// Bitmap generation the resolved pointers are valid for
+};
+
 enum class CursorType : uint8_t {
 	Text,
 	Graphics,
@@ -77,13 +95,14 @@ class Context {
 		Point *			activeCursor = &textCursor;		// Pointer to the active text cursor (textCursor or p1)
 		TickType_t		cursorTime;						// Time of last cursor flash event
 		uint8_t			cursorCtrlPauseFrames = 3;		// Number of frames to pause on newline when ctrl held
+		std::deque<uint8_t>		textAdvances;			// Advances of variable width characters plotted along the current line, for backspace
 
 		// Cursor rendering
 		uint8_t			cursorVStart;					// Cursor vertical start offset
 		uint8_t			cursorVEnd;						// Cursor vertical end
 		uint8_t			cursorHStart;					// Cursor horizontal start offset
 		uint8_t			cursorHEnd;						// Cursor horizontal end
-		std::shared_ptr<Bitmap>	textCursorBitmap = nullptr;		// Pointer to the text cursor bitmap
+		std::shared_ptr<Bitmap>	textCursorBitmap = nullptr;		// Pointer to the text cursor bitmap, shared with copies of this context
 		std::shared_ptr<Sprite>	textCursorSprite = nullptr;		// Pointer to the text cursor sprite
 
 		// Paged mode tracking
@@ -110,7 +129,7 @@ class Context {
 		uint16_t		bitmapTransform = -1;			// Bitmap transform buffer ID
 		fabgl::LinePattern	linePattern = fabgl::LinePattern();				// Dotted line pattern
 		uint8_t			linePatternLength = 8;			// Dotted line pattern length
-		std::vector<uint16_t>	charToBitmap = std::vector<uint16_t>(256, 65535);	// character to bitmap mapping
+		std::shared_ptr<CharBitmapMapping>	charToBitmap = nullptr;	// character to bitmap mapping, shared with copies of this context until changed (nullptr for no mappings)
 		bool			plottingText = false;			// Are we currently plotting text?
 		bool			logicalCoords = true;			// Use BBC BASIC logical coordinates
 
@@ -120,6 +139,7 @@ class Context {
 		Point			rp1;							// Relative coordinates store for plot
 		Point			up1;							// Unscaled coordinates store for plot
 		std::vector<Point>	pathPoints;					// Storage for path points
+		bool			pathNonZero = false;			// Fill paths with the non-zero winding rule (otherwise even-odd)
 		uint8_t			lastPlotCommand = 0;			// Tracking of last plot command to allow continuing plots
 
 		// Cursor management functions
@@ -178,19 +198,28 @@ class Context {
 		// Font management functions
 		const fabgl::FontInfo * getFont();
 		void changeFont(std::shared_ptr<fabgl::FontInfo> newFont, std::shared_ptr<BufferStream> fontData, uint8_t flags);
-		bool cmpChar(uint8_t * c1, uint8_t *c2, uint8_t len);
 		char getScreenChar(Point p);
 		inline void setCharacterOverwrite(bool overwrite);		// TODO integrate into setActiveCursor?
-		inline std::shared_ptr<Bitmap> getBitmapFromChar(uint8_t c) {
-			return getBitmap(charToBitmap[c]);
+		inline Bitmap * getBitmapFromChar(uint8_t c) {
+			if (!charToBitmap) {
+				return nullptr;
+			}
+			if (charToBitmap->generation != bitmapGeneration) {
+				resolveCharToBitmap();
+			}
+			return charToBitmap->resolved[c];
 		}
+		void resolveCharToBitmap();
+		std::vector<uint16_t> & getCharToBitmapForWrite();
 
 		// Graphics functions
 		fabgl::PaintOptions getPaintOptions(fabgl::PaintMode mode, fabgl::PaintOptions priorPaintOptions);
 		void setGraphicsOptions(uint8_t mode);
 		void setGraphicsFill(uint8_t mode);
+		bool plotPushed(uint8_t command);
 		void updateColours(uint8_t logical, uint8_t physical);
 		inline void setClippingRect(Rect rect);
+		void scrollNarrowRegion(Rect * region, int16_t scroll);
 
 		void pushPoint(Point p);
 		void pushPointRelative(int16_t x, int16_t y);
@@ -199,22 +228,29 @@ class Context {
 		void plotLine(bool omitFirstPoint, bool omitLastPoint, bool usePattern, bool resetPattern);
 		void plotPoint();
 		void fillHorizontalLine(bool scanLeft, bool match, RGB888 matchColor);
+		void plotFloodFill(bool untilForeground);
 		void plotTriangle();
 		void plotRectangle();
 		void plotParallelogram();
 		void plotCircle(bool filled);
+		void plotEllipse(bool filled);
 		void plotArc();
 		void plotSegment();
 		void plotSector();
+		void plotArcLimited(bool filled, bool chord);
+		void plotEllipseSpans(Point centre, int16_t a, int16_t b, int16_t shearX, int16_t shearY, bool filled, const ArcLimits * limits);
 		void plotCopyMove(uint8_t mode);
 		void plotPath(uint8_t mode, uint8_t lastMode);
+		void fillPolygon(const Point * points, size_t count, bool nonZero);
 		void plotBitmap(uint8_t mode);
+		void markPlotDirty(uint8_t operation);
 
 		void clearViewport(ViewportType viewport);
 		void scrollRegion(Rect * region, uint8_t direction, int16_t movement);
 
 		uint16_t scanH(int16_t x, int16_t y, RGB888 colour, int8_t direction);
 		uint16_t scanHToMatch(int16_t x, int16_t y, RGB888 colour, int8_t direction);
+		uint16_t scanHUntil(int16_t x, int16_t y, RGB888 colour, int8_t direction, bool stopOnMatch);
 
 	public:
 
@@ -262,8 +298,9 @@ class Context {
 		inline void cursorDown() {
 			cursorDown(false);
 		}
-		void cursorLeft();
+		uint8_t cursorLeft();
 		void cursorRight();
+		void cursorRight(uint8_t advance);
 		void cursorCR(Point * cursor, Rect * viewport);
 		inline void cursorCR() {
 			cursorCR(activeCursor, activeViewport);
@@ -278,7 +315,7 @@ class Context {
 		bool cursorScrollOrWrap();
 		void resetPagedModeCount();
 		uint8_t getCharsRemainingInLine();
-		bool cursorAutoNewline();
+		bool cursorAutoNewline(uint8_t advance = 0);
 
 		// Viewport management functions
 		void viewportReset();
@@ -297,6 +334,7 @@ class Context {
 		Point scale(int16_t X, int16_t Y);
 		Point toCurrentCoordinates(int16_t X, int16_t Y);
 		Point toScreenCoordinates(int16_t X, int16_t Y);
+		void toScreenCoordinates(const Point * points, Point * screenPoints, size_t count);
 
 		// Font management functions
 		void changeFont(uint16_t newFontId, uint8_t flags);
@@ -330,9 +368,11 @@ class Context {
 		Rect getGraphicsRect();							// Used by sprites system to capture screen area
 
 		bool plot(int16_t x, int16_t y, uint8_t command);
+		bool plot(Point point, Point screenPoint, uint8_t command);
 		void plotPending(int16_t peeked);
 
 		void plotString(const std::string & s);
+		size_t plotCharBitmapRun(const std::string & s, size_t start);
 		void plotBackspace();
 		void drawBitmap(uint16_t x, uint16_t y, bool compensateHeight, bool forceSet);
 
@@ -383,18 +423,12 @@ Context::Context(const Context &c) {
 	cursorTime = c.cursorTime;
 	cursorCtrlPauseFrames = c.cursorCtrlPauseFrames;
 
-	// Clone our text cursor sprite, if we have one, and we can
+	// Share our text cursor bitmap, which gets replaced rather than changed while shared,
+	// and clone the text cursor sprite if we have one, as it tracks our own cursor position
 	// TODO: Cursor - update this when we support custom cursor bitmaps/sprites
 	if (c.textCursorBitmap) {
-		// Copy our bitmap data
-		auto data = (uint8_t*)ps_malloc(c.textCursorBitmap->width * c.textCursorBitmap->height);
-		if (data) {
-			memcpy(data, c.textCursorBitmap->data, c.textCursorBitmap->width * c.textCursorBitmap->height);
-			textCursorBitmap = std::make_shared<Bitmap>(c.textCursorBitmap->width, c.textCursorBitmap->height, data, c.textCursorBitmap->format, true);
-		} else {
-			textCursorBitmap = nullptr;
-		}
-		if (textCursorBitmap && c.textCursorSprite) {
+		textCursorBitmap = c.textCursorBitmap;
+		if (c.textCursorSprite) {
 			// Create a new sprite for the text cursor
 			textCursorSprite = make_shared_psram<Sprite>();
 			if (textCursorSprite) {
@@ -433,6 +467,7 @@ Context::Context(const Context &c) {
 	currentBitmap = c.currentBitmap;
 	linePattern.setPattern(c.linePattern.pattern);
 	linePatternLength = c.linePatternLength;
+	pathNonZero = c.pathNonZero;
 
 	// Graphics positioning data
 	logicalCoords = c.logicalCoords;
@@ -452,7 +487,7 @@ Context::Context(const Context &c) {
 	tbgc = c.tbgc;
 	tpo = c.tpo;
 	cpo = c.cpo;
-	charToBitmap = c.charToBitmap;
+	charToBitmap = c.charToBitmap;		// shared until either context changes its mappings
 
 	if (c.activeCursor == &c.textCursor) {
 		activeCursor = &textCursor;
@@ -489,9 +524,9 @@ bool Context::readVariable(uint16_t var, uint16_t * value) {
 	}
 	if (var >= VDU_VAR_CHARMAPPING && var <= VDU_VAR_CHARMAPPING_END) {
 		auto c = var - VDU_VAR_CHARMAPPING;
-		if (charToBitmap[c] != 65535) {
+		if (charToBitmap && charToBitmap->ids[c] != 65535) {
 			if (value) {
-				*value = charToBitmap[c];
+				*value = charToBitmap->ids[c];
 			}
 			return true;
 		}
@@ -575,6 +610,11 @@ bool Context::readVariable(uint16_t var, uint16_t * value) {
 				*value = waitForFrames;
 			}
 			break;
+		case 0x24:	// Path fill rule (0 = even-odd, 1 = non-zero winding)
+			if (value) {
+				*value = pathNonZero ? 1 : 0;
+			}
+			break;
 
 		case 0x55:	// Current screen mode number
 			if (value) {
@@ -1023,6 +1063,9 @@ void Context::setVariable(uint16_t var, uint16_t value) {
 		case 0x23:	// Number of frames currently being waited for
 			setWaitForFrames(value);
 			break;
+		case 0x24:	// Path fill rule (0 = even-odd, 1 = non-zero winding)
+			pathNonZero = value != 0;
+			break;
 
 		case 0x56:	// Legacy modes flag
 			setLegacyModes(value);
@@ -3,6 +3,7 @@
 
 #include <fabgl.h>
 
+#include "agon_fonts.h"
 #include "agon_ps2.h"
 
 // Definitions for the functions we're implementing here
@@ -191,8 +192,11 @@ bool Context::cursorScrollOrWrap() {
 	return true;
 }
 
-bool Context::cursorAutoNewline() {
-	if (cursorIsOffRight() && (textCursorActive() || !cursorBehaviour.grNoSpecialActions)) {
+// Move to a new line if the cursor is off right
+// or, given a character advance, if a character of that width would not fit on the current line
+bool Context::cursorAutoNewline(uint8_t advance) {
+	bool offRight = cursorIsOffRight() || (advance > 0 && getNormalisedCursorPosition().X + advance > getNormalisedViewportWidth());
+	if (offRight && (textCursorActive() || !cursorBehaviour.grNoSpecialActions)) {
 		cursorCR();
 		cursorDown();
 		return true;
@@ -219,12 +223,8 @@ void Context::deleteTextCursor() {
 	if (textCursorSprite != nullptr) {
 		textCursorSprite = nullptr;
 	}
-	if (textCursorBitmap != nullptr) {
-		if (textCursorBitmap->data != nullptr) {
-			heap_caps_free(textCursorBitmap->data);
-		}
-		textCursorBitmap = nullptr;
-	}
+	// bitmap data is freed once no context is sharing the bitmap
+	textCursorBitmap = nullptr;
 }
 
 void Context::updateTextCursorBitmap() {
@@ -261,8 +261,9 @@ void Context::updateTextCursorBitmap() {
 		|| textCursorBitmap->height != height;
 
 	// If this info doesn't match our current bitmap, we may need to create a new one
+	// which we also need if our bitmap is shared with another context
 	if (differentSize || (textCursorBitmap->foregroundColor.R != cursorColor)) {
-		if (!differentSize) {
+		if (!differentSize && textCursorBitmap.use_count() == 1) {
 			// size matches so colour must be different - update it
 			memset(textCursorBitmap->data, cursorColor, width * height);
 			// update the tracking colour on the bitmap
@@ -282,13 +283,18 @@ void Context::updateTextCursorBitmap() {
 			// fill the data block with the cursor colour
 			memset(data, cursorColor, width * height);
 	
-			textCursorBitmap = make_shared_psram<Bitmap>(width, height, data, PixelFormat::RGBA2222, cursorRGB);
-			if (!textCursorBitmap) {
+			auto bitmap = make_unique_psram<Bitmap>(width, height, data, PixelFormat::RGBA2222, cursorRGB);
+			if (!bitmap) {
 				// if we couldn't create the bitmap, free the data and return
 				heap_caps_free(data);
 				debug_log("Failed to create text cursor bitmap\n");
 				return;
 			}
+			// the bitmap owns its data, freeing it when the last context using it lets go
+			textCursorBitmap = std::shared_ptr<Bitmap>(bitmap.release(), [](Bitmap * cursorBitmap) {
+				heap_caps_free(cursorBitmap->data);
+				delete cursorBitmap;
+			});
 			debug_log("Created text cursor bitmap %dx%d with colour %02x\n",
 				textCursorBitmap->width, textCursorBitmap->height, cursorColor);
 		}
@@ -519,6 +525,7 @@ void Context::resetTextCursor() {
 //
 void Context::cursorUp(bool moveOnly) {
 	auto font = getFont();
+	textAdvances.clear();
 	if (cursorBehaviour.flipXY) {
 		activeCursor->X += (cursorBehaviour.invertHorizontal ? font->width : -font->width);
 	} else {
@@ -534,6 +541,7 @@ void Context::cursorUp(bool moveOnly) {
 //
 void Context::cursorDown(bool moveOnly) {
 	auto font = getFont();
+	textAdvances.clear();
 	if (cursorBehaviour.flipXY) {
 		activeCursor->X += (cursorBehaviour.invertHorizontal ? -font->width : font->width);
 	} else {
@@ -546,31 +554,53 @@ void Context::cursorDown(bool moveOnly) {
 }
 
 // Move the active cursor back one character
+// Returns how far the cursor moved along the line, which for a variable width font
+// is the advance of the character last plotted there
 //
-void Context::cursorLeft() {
+uint8_t Context::cursorLeft() {
 	auto font = getFont();
+	uint8_t advance = font->width;
 	if (cursorBehaviour.flipXY) {
 		activeCursor->Y += (cursorBehaviour.invertVertical ? font->height : -font->height);
 	} else {
-		activeCursor->X += (cursorBehaviour.invertHorizontal ? font->width : -font->width);
+		if (!textAdvances.empty()) {
+			advance = textAdvances.back();
+			textAdvances.pop_back();
+		}
+		activeCursor->X += (cursorBehaviour.invertHorizontal ? advance : -advance);
 	}
 	updateTextCursorPosition();
 	if (cursorScrollOrWrap()) {
 		// wrapped, so move cursor up a line
 		cursorUp();
 	}
+	return advance;
 }
 
 // Advance the active cursor right one character
 // NB for scroll protect reasons, auto-newline must be handled by the caller
 //
 void Context::cursorRight() {
+	cursorRight(getFont()->width);
+}
+
+// Advance the active cursor right by a character advance, for variable width fonts
+// Vertical movement (when X and Y are flipped) is always by the font height
+//
+void Context::cursorRight(uint8_t advance) {
 	auto font = getFont();
 
 	if (cursorBehaviour.flipXY) {
 		activeCursor->Y += (cursorBehaviour.invertVertical ? -font->height : font->height);
 	} else {
-		activeCursor->X += (cursorBehaviour.invertHorizontal ? -font->width : font->width);
+		activeCursor->X += (cursorBehaviour.invertHorizontal ? -advance : advance);
+		if (isVariableWidthFont(font)) {
+			// remember the advance so backspace can step back over it
+			if (textAdvances.size() >= 256) {
+				textAdvances.pop_front();
+			}
+			textAdvances.push_back(advance);
+		}
 	}
 	updateTextCursorPosition();
 }
@@ -578,6 +608,7 @@ void Context::cursorRight() {
 // Move the active cursor to the leftmost position in the viewport
 //
 void Context::cursorCR(Point * cursor, Rect * viewport) {
+	textAdvances.clear();
 	if (cursorBehaviour.flipXY) {
 		cursor->Y = cursorBehaviour.invertVertical ? (viewport->Y2 + 1 - getFont()->height - getYAdjustment()) : viewport->Y1;
 	} else {
@@ -597,6 +628,7 @@ void Context::cursorHome(Point * cursor, Rect * viewport) {
 //
 void Context::cursorTab(uint8_t x, uint8_t y) {
 	auto font = getFont();
+	textAdvances.clear();
 	int xPos, yPos;
 	if (cursorBehaviour.flipXY) {
 		if (cursorBehaviour.invertHorizontal) {
@@ -636,6 +668,7 @@ void Context::cursorRelativeMove(int8_t x, int8_t y) {
 	// perform a pixel-relative movement of the cursor
 	// does _not_ obey cursor behaviour for directions
 	// but does for wrapping and scrolling
+	textAdvances.clear();
 	activeCursor->X += x;
 	activeCursor->Y += y;
 	updateTextCursorPosition();
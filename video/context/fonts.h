@@ -7,6 +7,7 @@
 
 #include "agon.h"
 #include "agon_fonts.h"
+#include "agon_screen.h"
 #include "context.h"
 
 // Private font management functions
@@ -24,11 +25,8 @@ void Context::changeFont(std::shared_ptr<fabgl::FontInfo> newFont, std::shared_p
 	}
 	auto newFontPtr = newFont == nullptr ? &FONT_AGON : newFont.get();
 	auto oldFontPtr = getFont();
+	textAdvances.clear();
 
-	if (newFontPtr->flags & FONTINFOFLAGS_VARWIDTH) {
-		debug_log("changeFont: variable width fonts not supported - yet\n\r");
-		return;
-	}
 	// adjust our cursor position, according to flags
 	if (flags & FONT_SELECTFLAG_ADJUSTBASE) {
 		int8_t x = 0;
@@ -67,15 +65,6 @@ void Context::changeFont(std::shared_ptr<fabgl::FontInfo> newFont, std::shared_p
 	}
 }
 
-bool Context::cmpChar(uint8_t * c1, uint8_t *c2, uint8_t len) {
-	for (uint8_t i = 0; i < len; i++) {
-		if (*c1++ != *c2++) {
-			return false;
-		}
-	}
-	return true;
-}
-
 char Context::getScreenChar(Point p) {
 	auto fontPtr = getFont();
 	if (fontPtr->flags & FONTINFOFLAGS_VARWIDTH) {
@@ -97,41 +86,44 @@ char Context::getScreenChar(Point p) {
 		uint8_t charWidthBytes = (fontWidth + 7) / 8;
 		uint8_t charSize = charWidthBytes * fontHeight;
 		uint8_t	charData[charSize];
-		uint8_t R = tbg.R;
-		uint8_t G = tbg.G;
-		uint8_t B = tbg.B;
 
-		// Now scan the screen and get the 8 byte pixel representation in charData
+		// Now read the screen a row at a time, as a mask of non-background pixels,
+		// and pack it into the same format as the font data in charData
 		//
+		memset(charData, 0, charSize);
 		for (uint8_t y = 0; y < fontHeight; y++) {
-			uint8_t readByte = 0;
-			for (uint8_t x = 0; x < fontWidth; x++) {
-				if ((x % 8) == 0) {
-					readByte = 0;
-				}
-				RGB888 pixel = canvas->getPixel(p.X + x, p.Y + y);
-				if (!(pixel.R == R && pixel.G == G && pixel.B == B)) {
-					readByte |= (0x80 >> (x % 8));
-				}
-				if ((x % 8) == 7) {
-					charData[(y * charWidthBytes) + (x / 8)] = readByte;
+			auto row = &charData[y * charWidthBytes];
+			for (int x = 0; x < fontWidth; x += 32) {
+				auto mask = readScreenRowMask(p.X + x, p.X + std::min(x + 31, fontWidth - 1), p.Y + y, tbg, false);
+				while (mask) {
+					auto px = x + __builtin_ctz(mask);
+					row[px >> 3] |= 0x80 >> (px & 7);
+					mask &= mask - 1;
 				}
 			}
-			charData[((y + 1) * charWidthBytes) - 1] = readByte;
 		}
 
-		// Finally try and match with the character set array
-		// starts at space character (32) and goes beyond the normal ASCII range
-		// Character checked is ANDed with 0xFF, so we check 32-255 then 0-31
-		// thus allowing characters 0-31 to be checked after conventional characters
+		// Finally look up the character in the glyph index for the font
+		// which matches in the same order as scanning characters 32-255 then 0-31
+		// thus allowing characters 0-31 to be matched after conventional characters
 		// as by default those characters are the same as space
 		//
-		for (auto i = 32; i <= (255 + 31); i++) {
-			uint8_t c = i & 0xFF;
-			if (cmpChar(charData, getCharPtr(font, c), charSize)) {
-				debug_log("getScreenChar: matched character %d\n\r", c);
-				return c;
+		auto c = findGlyph(font, charData, charSize);
+		if (c == -1) {
+			// No match, so try again as inverse video (character drawn in the background colour)
+			uint8_t lastByteMask = 0xFF << ((8 - (fontWidth & 7)) & 7);
+			for (uint8_t y = 0; y < fontHeight; y++) {
+				auto row = &charData[y * charWidthBytes];
+				for (uint8_t i = 0; i < charWidthBytes; i++) {
+					row[i] = ~row[i];
+				}
+				row[charWidthBytes - 1] &= lastByteMask;
 			}
+			c = findGlyph(font, charData, charSize);
+		}
+		if (c != -1) {
+			debug_log("getScreenChar: matched character %d\n\r", c);
+			return c;
 		}
 	}
 	return 0;
@@ -199,27 +191,53 @@ char Context::getScreenCharAt(uint16_t px, uint16_t py) {
 	return getScreenChar(toScreenCoordinates(px, py));
 }
 
+// Resolve the bitmaps our mapped characters use
+//
+void Context::resolveCharToBitmap() {
+	auto &mapping = *charToBitmap;
+	for (auto i = 0; i < 256; i++) {
+		mapping.resolved[i] = mapping.ids[i] == 65535 ? nullptr : getBitmap(mapping.ids[i]).get();
+	}
+	mapping.generation = bitmapGeneration;
+}
+
+// Get our character to bitmap mapping IDs ready to be changed
+// The mapping is created on first use, and copied if it is still shared with another context
+//
+std::vector<uint16_t> & Context::getCharToBitmapForWrite() {
+	if (!charToBitmap) {
+		charToBitmap = make_shared_psram<CharBitmapMapping>();
+	} else if (charToBitmap.use_count() > 1) {
+		charToBitmap = make_shared_psram<CharBitmapMapping>(*charToBitmap);
+	}
+	// resolved bitmaps will need refreshing
+	charToBitmap->generation = 0;
+	return charToBitmap->ids;
+}
+
 void Context::mapCharToBitmap(uint8_t c, uint16_t bitmapId) {
 	auto bitmap = getBitmap(bitmapId);
 	if (bitmap) {
-		charToBitmap[c] = bitmapId;
+		getCharToBitmapForWrite()[c] = bitmapId;
 	} else {
 		debug_log("mapCharToBitmap: bitmap %d not found\n\r", bitmapId);
-		charToBitmap[c] = 65535;
+		if (charToBitmap) {
+			getCharToBitmapForWrite()[c] = 65535;
+		}
 	}
 }
 
 void Context::unmapBitmapFromChars(uint16_t bitmapId) {
-	// remove this bitmap from the charToBitmap mapping
-	for (auto it = charToBitmap.begin(); it != charToBitmap.end(); it++) {
-		if (*it == bitmapId) {
-			*it = 65535;
-		}
+	// remove this bitmap from the charToBitmap mapping, only taking our own copy of the mapping if it's used
+	if (!charToBitmap || std::find(charToBitmap->ids.begin(), charToBitmap->ids.end(), bitmapId) == charToBitmap->ids.end()) {
+		return;
 	}
+	auto &mapping = getCharToBitmapForWrite();
+	std::replace(mapping.begin(), mapping.end(), bitmapId, (uint16_t)65535);
 }
 
 void Context::resetCharToBitmap() {
-	std::fill(charToBitmap.begin(), charToBitmap.end(), 65535);
+	charToBitmap = nullptr;
 }
 
 #endif // CONTEXT_FONTS_H
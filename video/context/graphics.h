@@ -42,19 +42,19 @@ void Context::setGraphicsOptions(uint8_t mode) {
 		case 0: break;	// move command
 		case 1: {
 			// use fg colour
-			canvas->setPenColor(gfg);
-			canvas->setPaintOptions(gpofg);
+			setCanvasPenColor(gfg);
+			setCanvasPaintOptions(gpofg);
 		} break;
 		case 2: {
 			// logical inverse colour - override paint options
 			auto options = getPaintOptions(fabgl::PaintMode::Invert, gpofg);
-			canvas->setPaintOptions(options);
+			setCanvasPaintOptions(options);
 			return;
 		} break;
 		case 3: {
 			// use bg colour
-			canvas->setPenColor(gbg);
-			canvas->setPaintOptions(gpobg);
+			setCanvasPenColor(gbg);
+			setCanvasPaintOptions(gpobg);
 		} break;
 	}
 }
@@ -67,12 +67,12 @@ void Context::setGraphicsFill(uint8_t mode) {
 		case 0: break;	// move command
 		case 1: {
 			// use fg colour
-			canvas->setBrushColor(gfg);
+			setCanvasBrushColor(gfg);
 		} break;
 		case 2: break;	// logical inverse colour (not suported)
 		case 3: {
 			// use bg colour
-			canvas->setBrushColor(gbg);
+			setCanvasBrushColor(gbg);
 		} break;
 	}
 }
@@ -102,7 +102,7 @@ void Context::updateColours(uint8_t logical, uint8_t physical) {
 // Set a clipping rectangle
 //
 inline void Context::setClippingRect(Rect rect) {
-	canvas->setClippingRect(rect);
+	setCanvasClippingRect(rect);
 }
 
 //// Graphics drawing routines (private)
@@ -144,7 +144,7 @@ void Context::plotLine(bool omitFirstPoint, bool omitLastPoint, bool usePattern,
 	if (resetPattern) {
 		canvas->setLinePatternOffset(0);
 	}
-	canvas->setLineOptions(lineOptions);
+	setCanvasLineOptions(lineOptions);
 
 	canvas->lineTo(p1.X, p1.Y);
 }
@@ -178,6 +178,277 @@ void Context::fillHorizontalLine(bool scanLeft, bool match, RGB888 matchColor) {
 	pushPoint(p.X, up1.Y);
 }
 
+// Span of pixels pending a flood fill scan, in viewport-relative coordinates
+//
+struct FloodFillSpan {
+	int16_t x1;
+	int16_t x2;
+	int16_t y;
+};
+
+// Flood fill
+// Scanline span fill from the graphics cursor, limited to the graphics viewport
+// &80 fills whilst pixels match the background colour, &88 fills until the foreground colour is found
+// Screen rows are read once on demand into a fillable pixel mask, so filled pixels are never
+// re-examined, which keeps non-Set paint modes (and fills with a matching colour) from looping
+// Spans that don't fit on the span stack are marked in a pending pixel mask instead, and re-seeded from there
+// whenever the stack empties, so large fills always complete without the stack growing any further
+//
+void Context::plotFloodFill(bool untilForeground) {
+	auto clip = graphicsViewport.intersection(Rect(0, 0, canvasW - 1, canvasH - 1));
+	if (p1.X < clip.X1 || p1.X > clip.X2 || p1.Y < clip.Y1 || p1.Y > clip.Y2) {
+		debug_log("plotFloodFill: (%d,%d) outside of graphics viewport\n\r", p1.X, p1.Y);
+		return;
+	}
+	int16_t width = clip.width();
+	int16_t height = clip.height();
+	int rowWords = (width + 31) >> 5;
+	auto matchColour = untilForeground ? gfg : gbg;
+
+	std::vector<uint32_t, psram_allocator<uint32_t>> fillable(rowWords * height, 0);
+	std::vector<uint8_t, psram_allocator<uint8_t>> rowLoaded(height, 0);
+	std::vector<FloodFillSpan, psram_allocator<FloodFillSpan>> spans;
+	std::vector<uint32_t, psram_allocator<uint32_t>> pending;
+
+	auto loadRow = [&](int16_t y) {
+		if (rowLoaded[y]) {
+			return;
+		}
+		auto bits = &fillable[y * rowWords];
+		for (int i = 0; i < rowWords; i++) {
+			int16_t x1 = clip.X1 + (i << 5);
+			bits[i] = readScreenRowMask(x1, std::min<int16_t>(x1 + 31, clip.X2), clip.Y1 + y, matchColour, !untilForeground);
+		}
+		rowLoaded[y] = 1;
+	};
+	auto isFillable = [&](int16_t x, int16_t y) {
+		return (fillable[y * rowWords + (x >> 5)] >> (x & 31)) & 1;
+	};
+	bool overflowed = false;
+	auto pushSpan = [&](int16_t x1, int16_t x2, int16_t y) {
+		if (y < 0 || y >= height) {
+			return;
+		}
+		if (spans.size() >= MAX_FLOOD_FILL_SPANS) {
+			if (pending.empty()) {
+				pending.resize(rowWords * height, 0);
+			}
+			auto bits = &pending[y * rowWords];
+			for (auto i = x1; i <= x2; i++) {
+				bits[i >> 5] |= 1u << (i & 31);
+			}
+			overflowed = true;
+			return;
+		}
+		spans.push_back({ x1, x2, y });
+	};
+	auto reseedPending = [&]() {
+		overflowed = false;
+		for (int16_t y = 0; y < height; y++) {
+			auto bits = &pending[y * rowWords];
+			int16_t x = 0;
+			while (x < width) {
+				if (bits[x >> 5] == 0) {
+					x = (x | 31) + 1;
+					continue;
+				}
+				if (!((bits[x >> 5] >> (x & 31)) & 1)) {
+					x++;
+					continue;
+				}
+				auto start = x;
+				while (x < width && ((bits[x >> 5] >> (x & 31)) & 1)) {
+					bits[x >> 5] &= ~(1u << (x & 31));
+					x++;
+				}
+				// spans that still don't fit are marked again, for the next pass
+				pushSpan(start, x - 1, y);
+			}
+		}
+	};
+
+	// Any queued drawing must be complete before we read from the screen
+	canvas->waitCompletion(false);
+
+	pushSpan(p1.X - clip.X1, p1.X - clip.X1, p1.Y - clip.Y1);
+	do {
+		if (overflowed) {
+			debug_log("plotFloodFill: span stack full, re-seeding pending spans\n\r");
+			reseedPending();
+		}
+		while (!spans.empty()) {
+			auto span = spans.back();
+			spans.pop_back();
+			loadRow(span.y);
+
+			auto x = span.x1;
+			while (x <= span.x2) {
+				if (!isFillable(x, span.y)) {
+					x++;
+					continue;
+				}
+				auto left = x;
+				auto right = x;
+				while (left > 0 && isFillable(left - 1, span.y)) {
+					left--;
+				}
+				while (right < width - 1 && isFillable(right + 1, span.y)) {
+					right++;
+				}
+				auto bits = &fillable[span.y * rowWords];
+				for (auto i = left; i <= right; i++) {
+					bits[i >> 5] &= ~(1u << (i & 31));
+				}
+				canvas->fillRectangle(clip.X1 + left, clip.Y1 + span.y, clip.X1 + right, clip.Y1 + span.y);
+
+				pushSpan(left, right, span.y - 1);
+				pushSpan(left, right, span.y + 1);
+				x = right + 2;
+			}
+		}
+	} while (overflowed);
+}
+
+// Polygon edge for the scanline polygon filler
+// x and dx are 16.16 fixed point, and the edge covers rows yTop to yBottom
+// Horizontal edges have yTop equal to yBottom, with x at their left end and dx their length
+//
+struct PolygonEdge {
+	int64_t x;
+	int64_t dx;
+	int16_t yTop;
+	int16_t yBottom;
+	int8_t winding;
+};
+
+// Edge pool, active edge list and row spans, kept between fills so most polygons need no allocations
+std::vector<PolygonEdge> polygonEdges;
+std::vector<PolygonEdge *> polygonActive;
+std::vector<std::pair<int16_t, int16_t>> polygonSpans;
+
+// Fill polygon
+// Active edge table scanline fill, drawing horizontal spans clipped to the graphics viewport
+// Both axes are inclusive, so the outline is filled along with the inside, as with the BBC Micro
+// Edges cross a row from their top row down to the row above their bottom one, so shared vertices are only counted once,
+// and the bottom pixel of each edge and any horizontal edges are added to the spans of their row
+// Each row's spans are merged before drawing, so no pixel is painted twice (safe for XOR etc)
+//
+void Context::fillPolygon(const Point * points, size_t count, bool nonZero) {
+	auto clip = graphicsViewport.intersection(Rect(0, 0, canvasW - 1, canvasH - 1));
+	if (polygonEdges.capacity() < POLYGON_EDGE_POOL_SIZE) {
+		polygonEdges.reserve(POLYGON_EDGE_POOL_SIZE);
+		polygonActive.reserve(POLYGON_EDGE_POOL_SIZE);
+		polygonSpans.reserve(POLYGON_EDGE_POOL_SIZE);
+	}
+	polygonEdges.clear();
+	polygonActive.clear();
+
+	int16_t minY = INT16_MAX, maxY = INT16_MIN;
+	for (size_t i = 0; i < count; i++) {
+		auto &a = points[i];
+		auto &b = points[i + 1 == count ? 0 : i + 1];
+		minY = std::min(minY, a.Y);
+		maxY = std::max(maxY, a.Y);
+		if (a.Y == b.Y) {
+			polygonEdges.push_back({
+				(int64_t)std::min(a.X, b.X) * 65536,
+				(int64_t)abs(b.X - a.X) * 65536,
+				a.Y,
+				a.Y,
+				0,
+			});
+			continue;
+		}
+		auto &top = a.Y < b.Y ? a : b;
+		auto &bottom = a.Y < b.Y ? b : a;
+		polygonEdges.push_back({
+			(int64_t)top.X * 65536,
+			((int64_t)(bottom.X - top.X) * 65536) / (bottom.Y - top.Y),
+			top.Y,
+			bottom.Y,
+			(int8_t)(a.Y < b.Y ? 1 : -1),
+		});
+	}
+
+	auto fillSpan = [&](int16_t x1, int16_t x2, int16_t y) {
+		x1 = std::max(x1, clip.X1);
+		x2 = std::min(x2, clip.X2);
+		if (x1 <= x2) {
+			canvas->fillRectangle(x1, y, x2, y);
+		}
+	};
+
+	std::sort(polygonEdges.begin(), polygonEdges.end(), [](const PolygonEdge &a, const PolygonEdge &b) {
+		return a.yTop < b.yTop;
+	});
+
+	size_t nextEdge = 0;
+	int16_t lastY = std::min(maxY, clip.Y2);
+	for (int16_t y = std::max(minY, clip.Y1); y <= lastY; y++) {
+		polygonSpans.clear();
+		polygonActive.erase(std::remove_if(polygonActive.begin(), polygonActive.end(), [y](const PolygonEdge * edge) {
+			return edge->yBottom < y;
+		}), polygonActive.end());
+		while (nextEdge < polygonEdges.size() && polygonEdges[nextEdge].yTop <= y) {
+			auto edge = &polygonEdges[nextEdge++];
+			if (edge->yBottom < y) {
+				continue;
+			}
+			if (edge->yTop == edge->yBottom) {
+				polygonSpans.push_back({ (int16_t)(edge->x >> 16), (int16_t)((edge->x + edge->dx) >> 16) });
+				continue;
+			}
+			// edges starting above the viewport are advanced to the first visible row
+			edge->x += edge->dx * (y - edge->yTop);
+			polygonActive.push_back(edge);
+		}
+
+		// active edges stay almost sorted from row to row, so an insertion sort is close to linear
+		for (size_t i = 1; i < polygonActive.size(); i++) {
+			auto edge = polygonActive[i];
+			auto j = i;
+			while (j > 0 && polygonActive[j - 1]->x > edge->x) {
+				polygonActive[j] = polygonActive[j - 1];
+				j--;
+			}
+			polygonActive[j] = edge;
+		}
+
+		int winding = 0;
+		int16_t spanStart = 0;
+		for (auto edge : polygonActive) {
+			int16_t x = (edge->x + 32768) >> 16;
+			if (edge->yBottom == y) {
+				// the edge ends on this row, so only its bottom pixel is added
+				polygonSpans.push_back({ x, x });
+				continue;
+			}
+			bool wasInside = winding != 0;
+			winding = nonZero ? winding + edge->winding : winding ^ 1;
+			if (!wasInside && winding != 0) {
+				spanStart = x;
+			} else if (wasInside && winding == 0) {
+				polygonSpans.push_back({ spanStart, x });
+			}
+		}
+
+		// merge overlapping and touching spans, so each pixel is drawn once
+		std::sort(polygonSpans.begin(), polygonSpans.end());
+		for (size_t i = 0; i < polygonSpans.size(); ) {
+			int16_t x1 = polygonSpans[i].first;
+			int16_t x2 = polygonSpans[i].second;
+			for (i++; i < polygonSpans.size() && polygonSpans[i].first <= x2 + 1; i++) {
+				x2 = std::max(x2, polygonSpans[i].second);
+			}
+			fillSpan(x1, x2, y);
+		}
+
+		for (auto edge : polygonActive) {
+			edge->x += edge->dx;
+		}
+	}
+}
+
 // Triangle plot
 //
 void Context::plotTriangle() {
@@ -189,7 +460,7 @@ void Context::plotTriangle() {
 	// if (gpo.mode == fabgl::PaintMode::Set) {
 	// 	canvas->drawPath(p, 3);
 	// }
-	canvas->fillPath(p, 3);
+	fillPolygon(p, 3, false);
 }
 
 // Rectangle plot
@@ -210,36 +481,227 @@ void Context::plotParallelogram() {
 	// if (gpo.mode == fabgl::PaintMode::Set) {
 	// 	canvas->drawPath(p, 4);
 	// }
-	canvas->fillPath(p, 4);
+	fillPolygon(p, 4, false);
+}
+
+// Integer division helpers for the ellipse rasteriser (divisor must be positive)
+//
+static inline int64_t floorDiv(int64_t n, int64_t d) {
+	return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+static inline int64_t ceilDiv(int64_t n, int64_t d) {
+	return n >= 0 ? (n + d - 1) / d : -((-n) / d);
+}
+
+// Range of x for which a * x + b >= 0, limited to +/- 65536
+//
+static inline void halfPlaneRange(int64_t a, int64_t b, int32_t &x1, int32_t &x2) {
+	int64_t lo = -65536, hi = 65536;
+	if (a > 0) {
+		lo = std::max(lo, ceilDiv(-b, a));
+	} else if (a < 0) {
+		hi = std::min(hi, floorDiv(b, -a));
+	} else if (b < 0) {
+		lo = 1;
+		hi = 0;
+	}
+	x1 = lo;
+	x2 = hi;
+}
+
+// Ranges of x on row y (both relative to the centre, y up) that pass the arc limits
+// Returns the number of ranges, which will be 0, 1 or 2
+//
+static int arcRowRanges(const ArcLimits &l, int32_t y, int32_t ranges[2][2]) {
+	if (l.chord) {
+		// on the arc side of the chord from start to end
+		halfPlaneRange(l.endY - l.startY, -(int64_t)l.startX * (l.endY - l.startY) - (int64_t)(y - l.startY) * (l.endX - l.startX), ranges[0][0], ranges[0][1]);
+		return ranges[0][0] <= ranges[0][1] ? 1 : 0;
+	}
+	// anticlockwise of the start, and clockwise of the end
+	int32_t a1, a2, b1, b2;
+	halfPlaneRange(-l.startY, (int64_t)l.startX * y, a1, a2);
+	halfPlaneRange(l.endY, -(int64_t)l.endX * y, b1, b2);
+	if (!l.reflex) {
+		ranges[0][0] = std::max(a1, b1);
+		ranges[0][1] = std::min(a2, b2);
+		return ranges[0][0] <= ranges[0][1] ? 1 : 0;
+	}
+	bool hasA = a1 <= a2;
+	bool hasB = b1 <= b2;
+	if (hasA && hasB && a1 <= b2 + 1 && b1 <= a2 + 1) {
+		ranges[0][0] = std::min(a1, b1);
+		ranges[0][1] = std::max(a2, b2);
+		return 1;
+	}
+	int count = 0;
+	if (hasA) {
+		ranges[count][0] = a1;
+		ranges[count++][1] = a2;
+	}
+	if (hasB) {
+		ranges[count][0] = b1;
+		ranges[count++][1] = b2;
+	}
+	return count;
+}
+
+// Half widths of each row of the current ellipse, reused between plots
+std::vector<int16_t> ellipseHalfWidths;
+
+// Ellipse rasteriser
+// Midpoint algorithm for an axis-aligned ellipse with radii a and b, optionally sheared so
+// that the top row is offset shearX pixels from the centre, where shearY is the top row's y offset
+// Output is horizontal spans, either whole rows (filled) or the outline pieces of each row,
+// limited to an arc, sector or segment when limits are given
+//
+void Context::plotEllipseSpans(Point centre, int16_t a, int16_t b, int16_t shearX, int16_t shearY, bool filled, const ArcLimits * limits) {
+	auto clip = graphicsViewport.intersection(Rect(0, 0, canvasW - 1, canvasH - 1));
+	a = abs(a);
+	b = abs(b);
+	ellipseHalfWidths.assign(b + 1, 0);
+
+	if (b == 0) {
+		ellipseHalfWidths[0] = a;
+	} else {
+		// all decision values are scaled by 4 to keep them integer
+		int64_t a2 = (int64_t)a * a;
+		int64_t b2 = (int64_t)b * b;
+		int32_t x = 0;
+		int32_t y = b;
+		int64_t dx = 0;
+		int64_t dy = 2 * a2 * y;
+		int64_t d = 4 * b2 - 4 * a2 * b + a2;
+		while (dx < dy) {
+			ellipseHalfWidths[y] = x;
+			x++;
+			dx += 2 * b2;
+			if (d < 0) {
+				d += 4 * (dx + b2);
+			} else {
+				y--;
+				dy -= 2 * a2;
+				d += 4 * (dx - dy + b2);
+			}
+		}
+		d = b2 * (2 * x + 1) * (2 * x + 1) + 4 * a2 * (int64_t)(y - 1) * (y - 1) - 4 * a2 * b2;
+		while (y >= 0) {
+			ellipseHalfWidths[y] = std::max<int32_t>(ellipseHalfWidths[y], x);
+			y--;
+			dy -= 2 * a2;
+			if (d > 0) {
+				d += 4 * (a2 - dy);
+			} else {
+				x++;
+				dx += 2 * b2;
+				d += 4 * (dx - dy + a2);
+			}
+		}
+	}
+
+	// left and right edges of a row, relative to the centre
+	auto rowLeft = [&](int32_t row) {
+		auto shift = shearY ? floorDiv(2 * (int64_t)shearX * row * (shearY > 0 ? 1 : -1) + abs(shearY), 2 * abs(shearY)) : 0;
+		return (int32_t)shift - ellipseHalfWidths[abs(row)];
+	};
+	auto rowRight = [&](int32_t row) {
+		return rowLeft(row) + 2 * ellipseHalfWidths[abs(row)];
+	};
+	auto emit = [&](int32_t x1, int32_t x2, int32_t row) {
+		int32_t ranges[2][2] = { { x1, x2 }, { 0, 0 } };
+		int count = 1;
+		if (limits) {
+			count = arcRowRanges(*limits, -row, ranges);
+		}
+		for (int i = 0; i < count; i++) {
+			auto l = std::max<int32_t>(std::max(x1, ranges[i][0]) + centre.X, clip.X1);
+			auto r = std::min<int32_t>(std::min(x2, ranges[i][1]) + centre.X, clip.X2);
+			if (l <= r) {
+				canvas->fillRectangle(l, centre.Y + row, r, centre.Y + row);
+			}
+		}
+	};
+
+	auto firstRow = std::max<int32_t>(-b, clip.Y1 - centre.Y);
+	auto lastRow = std::min<int32_t>(b, clip.Y2 - centre.Y);
+	for (auto row = firstRow; row <= lastRow; row++) {
+		auto left = rowLeft(row);
+		auto right = rowRight(row);
+		if (filled || abs(row) == b) {
+			emit(left, right, row);
+			continue;
+		}
+		// outline pieces reach across to the edges of the neighbouring rows so the outline is connected
+		auto leftEnd = std::max(left, std::max(rowLeft(row - 1), rowLeft(row + 1)) - 1);
+		auto rightStart = std::min(right, std::min(rowRight(row - 1), rowRight(row + 1)) + 1);
+		if (leftEnd + 1 >= rightStart) {
+			emit(left, right, row);
+		} else {
+			emit(left, leftEnd, row);
+			emit(rightStart, right, row);
+		}
+	}
 }
 
 // Circle plot
 //
 void Context::plotCircle(bool filled) {
-	auto size = 2 * sqrt(rp1.X * rp1.X + (rp1.Y * rp1.Y * (rectangularPixels ? 4 : 1)));
-	if (filled) {
-		canvas->fillEllipse(p2.X, p2.Y, size, rectangularPixels ? size / 2 : size);
-	} else {
-		canvas->drawEllipse(p2.X, p2.Y, size, rectangularPixels ? size / 2 : size);
+	auto size = sqrt(rp1.X * rp1.X + (rp1.Y * rp1.Y * (rectangularPixels ? 4 : 1)));
+	int16_t radius = lroundf(size);
+	plotEllipseSpans(p2, radius, rectangularPixels ? radius / 2 : radius, 0, 0, filled, nullptr);
+}
+
+// Ellipse plot
+// Centre, then a point level with the centre giving the horizontal radius,
+// then the top of the ellipse, whose x offset shears the ellipse
+//
+void Context::plotEllipse(bool filled) {
+	plotEllipseSpans(p3, p2.X - p3.X, p1.Y - p3.Y, p1.X - p3.X, p1.Y - p3.Y, filled, nullptr);
+}
+
+// Arc, segment and sector plots
+// Centre, then the start point giving the radius, then a point in the direction of the end
+// drawn anticlockwise from start to end
+//
+void Context::plotArcLimited(bool filled, bool chord) {
+	ArcLimits limits;
+	limits.startX = p2.X - p3.X;
+	limits.startY = p3.Y - p2.Y;
+	limits.endX = p1.X - p3.X;
+	limits.endY = p3.Y - p1.Y;
+	limits.chord = chord;
+	auto radius = sqrtf((float)limits.startX * limits.startX + (float)limits.startY * limits.startY);
+	auto cross = (int64_t)limits.startX * limits.endY - (int64_t)limits.startY * limits.endX;
+	auto dot = (int64_t)limits.startX * limits.endX + (int64_t)limits.startY * limits.endY;
+	limits.reflex = cross < 0;
+	if (chord) {
+		// segment chords end on the circle
+		auto length = sqrtf((float)limits.endX * limits.endX + (float)limits.endY * limits.endY);
+		if (length > 0) {
+			limits.endX = lroundf(limits.endX * radius / length);
+			limits.endY = lroundf(limits.endY * radius / length);
+		}
 	}
+	// start and end in the same direction is a whole circle
+	bool whole = cross == 0 && dot >= 0;
+	plotEllipseSpans(p3, lroundf(radius), lroundf(radius), 0, 0, filled, whole ? nullptr : &limits);
 }
 
-// Arc plot
 void Context::plotArc() {
 	debug_log("plotArc: (%d,%d) -> (%d,%d), (%d,%d)\n\r", p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
-	canvas->drawArc(p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
+	plotArcLimited(false, false);
 }
 
 // Segment plot
 void Context::plotSegment() {
 	debug_log("plotSegment: (%d,%d) -> (%d,%d), (%d,%d)\n\r", p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
-	canvas->fillSegment(p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
+	plotArcLimited(true, true);
 }
 
 // Sector plot
 void Context::plotSector() {
 	debug_log("plotSector: (%d,%d) -> (%d,%d), (%d,%d)\n\r", p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
-	canvas->fillSector(p3.X, p3.Y, p2.X, p2.Y, p1.X, p1.Y);
+	plotArcLimited(true, false);
 }
 
 // Copy or move a rectangle
@@ -262,8 +724,8 @@ void Context::plotCopyMove(uint8_t mode) {
 	if (mode == 1 || mode == 5) {
 		// move rectangle needs to clear source rectangle
 		// being careful not to clear the destination rectangle
-		canvas->setBrushColor(gbg);
-		canvas->setPaintOptions(getPaintOptions(fabgl::PaintMode::Set, gpobg));
+		setCanvasBrushColor(gbg);
+		setCanvasPaintOptions(getPaintOptions(fabgl::PaintMode::Set, gpobg));
 		debug_log("plotCopyMove: source rectangle (%d,%d) -> (%d,%d)\n\r", sourceRect.X1, sourceRect.Y1, sourceRect.X2, sourceRect.Y2);
 		Rect destRect = Rect(destX, destY, destX + width, destY + height);
 		debug_log("plotCopyMove: destination rectangle (%d,%d) -> (%d,%d)\n\r", destRect.X1, destRect.Y1, destRect.X2, destRect.Y2);
@@ -326,15 +788,18 @@ void Context::plotPath(uint8_t mode, uint8_t lastMode) {
 			return;
 		}
 		debug_log("plotPath: drawing path\n\r");
+		#if DEBUG == 1
 		// iterate over our pathPoints and output in debug statement
 		for (auto p : pathPoints) {
 			debug_log("plotPath: (%d,%d)\n\r", p.X, p.Y);
 		}
+		#endif
 		debug_log("plotPath: setting graphics fill with lastMode %d\n\r", lastMode);
 		// i'm not entirely sure yet whether this is needed
 		setGraphicsOptions(lastMode);
 		setGraphicsFill(lastMode);
-		canvas->fillPath(pathPoints.data(), pathPoints.size());
+		fillPolygon(pathPoints.data(), pathPoints.size(), pathNonZero);
+		markDirty(graphicsViewport);
 		pathPoints.clear();
 		return;
 	}
@@ -348,6 +813,82 @@ void Context::plotPath(uint8_t mode, uint8_t lastMode) {
 	pathPoints.push_back(p1);
 }
 
+// Mark the area a plot operation may have drawn to as dirty
+// Bounds are conservative, and operations without cheap bounds dirty the whole graphics viewport
+//
+void Context::markPlotDirty(uint8_t operation) {
+	if (!dirtyTracking) {
+		return;
+	}
+	int16_t x1 = p1.X, y1 = p1.Y, x2 = p1.X, y2 = p1.Y;
+	auto include = [&](int16_t x, int16_t y) {
+		x1 = std::min(x1, x);
+		y1 = std::min(y1, y);
+		x2 = std::max(x2, x);
+		y2 = std::max(y2, y);
+	};
+	auto includeRadius = [&](Point centre, int16_t rx, int16_t ry) {
+		include(centre.X - rx, centre.Y - ry);
+		include(centre.X + rx, centre.Y + ry);
+	};
+
+	switch (operation) {
+		case 0x00: case 0x08: case 0x10: case 0x18:	// lines
+		case 0x20: case 0x28: case 0x30: case 0x38:
+			include(p2.X, p2.Y);
+			x1 -= lineThickness;
+			y1 -= lineThickness;
+			x2 += lineThickness;
+			y2 += lineThickness;
+			break;
+		case 0x40:	// point
+			break;
+		case 0xD8:	// path points are drawn when the path is committed
+		case 0xE8:	// bitmaps are marked by drawBitmap
+		case 0xD0:	// unassigned and unimplemented operations
+		case 0xE0:
+		case 0xF0:
+		case 0xF8:
+			return;
+		case 0x50:	// triangle
+			include(p2.X, p2.Y);
+			include(p3.X, p3.Y);
+			break;
+		case 0x60:	// rectangle
+			include(p2.X, p2.Y);
+			break;
+		case 0x70:	// parallelogram
+			include(p2.X, p2.Y);
+			include(p3.X, p3.Y);
+			include(p1.X + (p3.X - p2.X), p1.Y + (p3.Y - p2.Y));
+			break;
+		case 0x90:	// circles
+		case 0x98: {
+			int16_t radius = abs(rp1.X) + abs(rp1.Y) * (rectangularPixels ? 2 : 1);
+			includeRadius(p2, radius, radius);
+		}	break;
+		case 0xA0:	// arc, segment and sector
+		case 0xA8:
+		case 0xB0: {
+			int16_t radius = abs(p2.X - p3.X) + abs(p2.Y - p3.Y);
+			includeRadius(p3, radius, radius);
+		}	break;
+		case 0xB8:	// copy/move
+			include(p2.X, p2.Y);
+			include(p3.X, p3.Y);
+			include(p1.X + abs(p3.X - p2.X), p1.Y - abs(p3.Y - p2.Y));
+			break;
+		case 0xC0:	// ellipses
+		case 0xC8:
+			includeRadius(p3, abs(p2.X - p3.X) + abs(p1.X - p3.X), abs(p1.Y - p3.Y));
+			break;
+		default:	// fills
+			markDirty(graphicsViewport);
+			return;
+	}
+	markDirty(Rect(x1, y1, x2, y2).intersection(graphicsViewport));
+}
+
 // Plot bitmap
 //
 void Context::plotBitmap(uint8_t mode) {
@@ -356,7 +897,7 @@ void Context::plotBitmap(uint8_t mode) {
 		auto paintOptions = getPaintOptions(gpobg.mode, gpobg);
 		// swapFGBG on bitmap plots indicates to plot using pen color instead of bitmap
 		paintOptions.swapFGBG = true;
-		canvas->setPaintOptions(paintOptions);
+		setCanvasPaintOptions(paintOptions);
 	}
 	drawBitmap(p1.X, p1.Y, true, false);
 	plottingText = false;
@@ -371,15 +912,17 @@ void Context::clearViewport(ViewportType type) {
 	} else {
 		canvas->fillRectangle(*getViewport(type));
 	}
+	markDirty(*getViewport(type));
 }
 
 void Context::scrollRegion(Rect * region, uint8_t direction, int16_t movement) {
 	auto moveX = 0;
 	auto moveY = 0;
 	canvas->setScrollingRegion(region->X1, region->Y1, region->X2, region->Y2);
-	canvas->setPenColor(tbg);
-	canvas->setBrushColor(tbg);
-	canvas->setPaintOptions(tpo);
+	markDirty(*region);
+	setCanvasPenColor(tbg);
+	setCanvasBrushColor(tbg);
+	setCanvasPaintOptions(tpo);
 	plottingText = false;
 	switch (direction) {
 		case 0:		// Right
@@ -434,50 +977,81 @@ void Context::scrollRegion(Rect * region, uint8_t direction, int16_t movement) {
 					movement = getFont()->height;
 				}
 			}
-			canvas->scroll(movement * moveX, movement * moveY);
+			if (moveY != 0 && region->width() * 2 < canvasW) {
+				scrollNarrowRegion(region, movement * moveY);
+			} else {
+				canvas->scroll(movement * moveX, movement * moveY);
+			}
 		}
 	}
 	if (textCursorActive()) {
-		canvas->setPenColor(tfg);
-		canvas->setBrushColor(tbg);
+		setCanvasPenColor(tfg);
+		setCanvasBrushColor(tbg);
 	} else {
-		canvas->setPenColor(gfg);
-		canvas->setBrushColor(gfg);
-		canvas->setPaintOptions(gpofg);
+		setCanvasPenColor(gfg);
+		setCanvasBrushColor(gfg);
+		setCanvasPaintOptions(gpofg);
 	}
 }
 
 
+// Scroll a narrow region vertically, by copying the region itself and clearing the exposed rows
+// vdp-gl scrolls by rotating whole scanline pointers, which is ideal for full width viewports,
+// but then has to copy back every pixel either side of the region, so narrow regions are moved directly
+//
+void Context::scrollNarrowRegion(Rect * region, int16_t scroll) {
+	auto width = region->width();
+	auto height = region->height();
+	setClippingRect(*region);
+	if (abs(scroll) >= height) {
+		canvas->fillRectangle(*region);
+	} else if (scroll < 0) {
+		canvas->copyRect(region->X1, region->Y1 - scroll, region->X1, region->Y1, width, height + scroll);
+		canvas->fillRectangle(region->X1, region->Y2 + scroll + 1, region->X2, region->Y2);
+	} else {
+		canvas->copyRect(region->X1, region->Y1, region->X1, region->Y1 + scroll, width, height - scroll);
+		canvas->fillRectangle(region->X1, region->Y1, region->X2, region->Y1 + scroll - 1);
+	}
+}
+
 // Horizontal scan until we find a pixel not non-equalto given colour
 // returns x coordinate for the last pixel before the match
 uint16_t Context::scanH(int16_t x, int16_t y, RGB888 colour, int8_t direction = 1) {
-	uint16_t w = direction > 0 ? canvas->getWidth() - 1 : 0;
-	if (x < 0 || x >= canvas->getWidth()) return x;
-
-	while (x != w) {
-		RGB888 pixel = canvas->getPixel(x, y);
-		if (pixel == colour) {
-			x += direction;
-		} else {
-			return x - direction;
-		}
-	}
-
-	return w;
+	return scanHUntil(x, y, colour, direction, false);
 }
 
 // Horizontal scan until we find a pixel matching the given colour
 // returns x coordinate for the last pixel before the match
 uint16_t Context::scanHToMatch(int16_t x, int16_t y, RGB888 colour, int8_t direction = 1) {
-	uint16_t w = direction > 0 ? canvas->getWidth() - 1 : 0;
-	if (x < 0 || x >= canvas->getWidth()) return x;
+	return scanHUntil(x, y, colour, direction, true);
+}
 
-	while (x != w) {
-		RGB888 pixel = canvas->getPixel(x, y);
-		if (pixel == colour) {
-			return x - direction;
+// Horizontal scan until we find a pixel whose match against the given colour equals stopOnMatch
+// Pixels are read directly from the screen 32 at a time into a bit mask,
+// with the run boundary then found by counting trailing/leading zeros
+// returns x coordinate for the last pixel before the stopping pixel, or the screen edge
+uint16_t Context::scanHUntil(int16_t x, int16_t y, RGB888 colour, int8_t direction, bool stopOnMatch) {
+	uint16_t w = direction > 0 ? canvas->getWidth() - 1 : 0;
+	if (x < 0 || x >= canvas->getWidth() || y < 0 || y >= canvas->getHeight()) return x;
+
+	if (direction > 0) {
+		while (x < w) {
+			int16_t end = std::min<int16_t>(x + 31, w - 1);
+			auto mask = readScreenRowMask(x, end, y, colour, stopOnMatch);
+			if (mask) {
+				return x + __builtin_ctz(mask) - 1;
+			}
+			x = end + 1;
+		}
+	} else {
+		while (x > 0) {
+			int16_t start = std::max<int16_t>(x - 31, 1);
+			auto mask = readScreenRowMask(start, x, y, colour, stopOnMatch);
+			if (mask) {
+				return start + (31 - __builtin_clz(mask)) + 1;
+			}
+			x = start - 1;
 		}
-		x += direction;
 	}
 
 	return w;
@@ -519,7 +1093,7 @@ void Context::setTextColour(uint8_t colour) {
 		tfg = colourLookup[c];
 		tfgc = col;
 		if (plottingText && textCursorActive()) {
-			canvas->setPenColor(tfg);
+			setCanvasPenColor(tfg);
 		}
 		debug_log("vdu_colour: tfg %d = %02X : %02X,%02X,%02X\n\r", colour, c, tfg.R, tfg.G, tfg.B);
 	}
@@ -527,7 +1101,7 @@ void Context::setTextColour(uint8_t colour) {
 		tbg = colourLookup[c];
 		tbgc = col;
 		if (plottingText && textCursorActive()) {
-			canvas->setBrushColor(tbg);
+			setCanvasBrushColor(tbg);
 		}
 		debug_log("vdu_colour: tbg %d = %02X : %02X,%02X,%02X\n\r", colour, c, tbg.R, tbg.G, tbg.B);
 	}
@@ -628,18 +1202,32 @@ Rect Context::getGraphicsRect() {
 // Plot command handler
 //
 bool IRAM_ATTR Context::plot(int16_t x, int16_t y, uint8_t command) {
-	auto mode = command & 0x07;
-	auto operation = command & 0xF8;
-	bool pending = false;
-	plottingText = false;
-
-	if (mode < 4) {
+	if ((command & 0x07) < 4) {
 		pushPointRelative(x, y);
 	} else {
 		pushPoint(x, y);
 	}
+	return plotPushed(command);
+}
+
+// Plot command handler for an absolute plot command,
+// with a point that has already been converted to screen coordinates
+//
+bool Context::plot(Point point, Point screenPoint, uint8_t command) {
+	up1 = point;
+	pushPoint(screenPoint);
+	return plotPushed(command);
+}
+
+// Perform a plot command, once its point has been pushed
+//
+bool IRAM_ATTR Context::plotPushed(uint8_t command) {
+	auto mode = command & 0x07;
+	auto operation = command & 0xF8;
+	bool pending = false;
+	plottingText = false;
 
-	debug_log("vdu_plot: operation: %X, mode %d, lastPlotCommand %X, (%d,%d) -> (%d,%d)\n\r", operation, mode, lastPlotCommand, x, y, p1.X, p1.Y);
+	debug_log("vdu_plot: operation: %X, mode %d, lastPlotCommand %X, (%d,%d) -> (%d,%d)\n\r", operation, mode, lastPlotCommand, up1.X, up1.Y, p1.X, p1.Y);
 
 	if (((lastPlotCommand & 0xF8) == 0xD8) && ((lastPlotCommand & 0xFB) != (command & 0xFB))) {
 		debug_log("vdu_plot: last plot was a path, but different command detected\n\r");
@@ -704,10 +1292,15 @@ bool IRAM_ATTR Context::plot(int16_t x, int16_t y, uint8_t command) {
 				fillHorizontalLine(false, false, gfg);
 				break;
 			case 0x80:	// flood to non-bg
+				setGraphicsFill(mode);
+				plotFloodFill(false);
+				break;
 			case 0x88:	// flood to fg
-				debug_log("plot flood fill not implemented\n\r");
+				setGraphicsFill(mode);
+				plotFloodFill(true);
 				break;
 			case 0x90:	// circle outline
+				setGraphicsFill(mode);
 				plotCircle(false);
 				break;
 			case 0x98:	// circle fill
@@ -715,6 +1308,7 @@ bool IRAM_ATTR Context::plot(int16_t x, int16_t y, uint8_t command) {
 				plotCircle(true);
 				break;
 			case 0xA0:	// circular arc
+				setGraphicsFill(mode);
 				plotArc();
 				break;
 			case 0xA8:	// circular segment
@@ -729,9 +1323,12 @@ bool IRAM_ATTR Context::plot(int16_t x, int16_t y, uint8_t command) {
 				plotCopyMove(mode);
 				break;
 			case 0xC0:	// ellipse outline
+				setGraphicsFill(mode);
+				plotEllipse(false);
+				break;
 			case 0xC8:	// ellipse fill
-				// fab-gl's ellipse isn't compatible with BBC BASIC
-				debug_log("plot ellipse not implemented\n\r");
+				setGraphicsFill(mode);
+				plotEllipse(true);
 				break;
 			case 0xD8:	// plot path (unassigned on Acorn and other BBC BASIC versions)
 				plotPath(mode, lastPlotCommand & 0x03);
@@ -751,6 +1348,7 @@ bool IRAM_ATTR Context::plot(int16_t x, int16_t y, uint8_t command) {
 				debug_log("plot swap rectangle not implemented\n\r");
 				break;
 		}
+		markPlotDirty(operation);
 	}
 	lastPlotCommand = command;
 	moveTo();
@@ -766,42 +1364,111 @@ void Context::plotPending(int16_t peeked) {
 }
 
 
+// Plot a run of characters mapped to bitmaps of the same size, up to the end of the current line
+// Cursor checks, dirty marking and cursor movement are done once for the whole run
+// returns the number of characters plotted, or 0 if there's no run to plot
+//
+size_t Context::plotCharBitmapRun(const std::string& s, size_t start) {
+	auto first = getBitmapFromChar(s[start]);
+	if (!first) {
+		return 0;
+	}
+	auto font = getFont();
+	// number of characters that can start before the cursor is off the right of the viewport
+	int fit = (getNormalisedViewportWidth() - getNormalisedCursorPosition().X + font->width - 1) / font->width;
+	int count = 1;
+	while (start + count < s.size() && count < fit) {
+		auto bitmap = getBitmapFromChar(s[start + count]);
+		if (!bitmap || bitmap->width != first->width || bitmap->height != first->height) {
+			break;
+		}
+		count++;
+	}
+	if (count < 2) {
+		return 0;
+	}
+
+	auto x = activeCursor->X;
+	auto y = activeCursor->Y + font->height - first->height;
+	for (int i = 0; i < count; i++) {
+		canvas->drawBitmap(x + (i * font->width), y, getBitmapFromChar(s[start + i]));
+	}
+	markDirty(Rect(x, y, x + ((count - 1) * font->width) + first->width - 1, y + first->height - 1));
+
+	activeCursor->X += count * font->width;
+	updateTextCursorPosition();
+	if (cursorIsOffRight()) {
+		checkPagedMode();
+	}
+	return count;
+}
+
+// Character offsets of the string being plotted with a variable width font, reused between plots
+std::vector<uint32_t> textRunPrefix;
+
 // Plot a string
 //
 void Context::plotString(const std::string& s) {
 	if (!ttxtMode && !plottingText) {
 		if (textCursorActive()) {
 			setClippingRect(textViewport);
-			canvas->setPenColor(tfg);
-			canvas->setBrushColor(tbg);
-			canvas->setPaintOptions(tpo);
+			setCanvasPenColor(tfg);
+			setCanvasBrushColor(tbg);
+			setCanvasPaintOptions(tpo);
 		} else {
 			setClippingRect(graphicsViewport);
-			canvas->setPenColor(gfg);
-			canvas->setPaintOptions(gpofg);
+			setCanvasPenColor(gfg);
+			setCanvasPaintOptions(gpofg);
 		}
 		plottingText = true;
 	}
 
 	auto font = getFont();
+	// variable width fonts advance by each glyph's width, other than when characters are stacked vertically
+	bool proportional = !ttxtMode && isVariableWidthFont(font) && !cursorBehaviour.flipXY;
+	if (proportional) {
+		measureText(font, s, &textRunPrefix);
+	}
+	// runs of characters mapped to bitmaps can be plotted together when the cursor simply moves right
+	bool bitmapRuns = !ttxtMode && !proportional && charToBitmap
+		&& !cursorBehaviour.flipXY && !cursorBehaviour.invertHorizontal && !cursorBehaviour.xHold;
 	// iterate over the string and plot each character
-	for (const char c : s) {
-		if (cursorIsOffRight()) {
+	for (size_t i = 0; i < s.size(); i++) {
+		const char c = s[i];
+		uint8_t advance = proportional ? textRunPrefix[i + 1] - textRunPrefix[i] : font->width;
+		if (cursorIsOffRight() || proportional) {
 			// Cursor might be off right from scroll protect, or previous character plot
-			cursorAutoNewline();
+			// and a variable width character might not fit in the rest of the line
+			cursorAutoNewline(proportional ? advance : 0);
+		}
+		if (bitmapRuns) {
+			auto run = plotCharBitmapRun(s, i);
+			if (run > 0) {
+				i += run - 1;
+				continue;
+			}
 		}
 		if (ttxtMode) {
 			ttxt_instance.draw_char(activeCursor->X, activeCursor->Y, c);
 		} else {
 			auto bitmap = getBitmapFromChar(c);
 			if (bitmap) {
-				canvas->drawBitmap(activeCursor->X, activeCursor->Y + font->height - bitmap->height, bitmap.get());
+				canvas->drawBitmap(activeCursor->X, activeCursor->Y + font->height - bitmap->height, bitmap);
+				markDirty(Rect(activeCursor->X, activeCursor->Y + font->height - bitmap->height, activeCursor->X + bitmap->width - 1, activeCursor->Y + font->height - 1));
+			} else if (proportional) {
+				// right to left text keeps glyphs against the right of the character cell
+				auto x = cursorBehaviour.invertHorizontal ? activeCursor->X + font->width - advance : activeCursor->X;
+				if (advance > 0) {
+					canvas->drawGlyph(x, activeCursor->Y, advance, font->height, getCharGlyph(font, c), 0);
+					markDirty(Rect(x, activeCursor->Y, x + advance - 1, activeCursor->Y + font->height - 1));
+				}
 			} else {
 				canvas->drawChar(activeCursor->X, activeCursor->Y, c);
+				markDirty(Rect(activeCursor->X, activeCursor->Y, activeCursor->X + font->width - 1, activeCursor->Y + font->height - 1));
 			}
 		}
 		if (!cursorBehaviour.xHold) {
-			cursorRight();
+			cursorRight(advance);
 
 			if (cursorIsOffRight()) {
 				checkPagedMode();
@@ -818,12 +1485,21 @@ void Context::plotString(const std::string& s) {
 // Backspace plot
 //
 void Context::plotBackspace() {
-	cursorLeft();
+	auto advance = cursorLeft();
 	if (ttxtMode) {
 		ttxt_instance.draw_char(activeCursor->X, activeCursor->Y, ' ');
 	} else {
-		canvas->setBrushColor(textCursorActive() ? tbg : gbg);
-		canvas->fillRectangle(activeCursor->X, activeCursor->Y, activeCursor->X + getFont()->width - 1, activeCursor->Y + getFont()->height - 1);
+		auto font = getFont();
+		// erase only the deleted character, which right to left text keeps against the right of the cell
+		auto x = cursorBehaviour.invertHorizontal ? activeCursor->X + font->width - advance : activeCursor->X;
+		if (cursorBehaviour.flipXY) {
+			x = activeCursor->X;
+			advance = font->width;
+		}
+		Rect area(x, activeCursor->Y, x + advance - 1, activeCursor->Y + font->height - 1);
+		setCanvasBrushColor(textCursorActive() ? tbg : gbg);
+		canvas->fillRectangle(area);
+		markDirty(area);
 		plottingText = false;
 	}
 }
@@ -835,7 +1511,7 @@ void Context::drawBitmap(uint16_t x, uint16_t y, bool compensateHeight, bool for
 	if (bitmap) {
 		if (forceSet) {
 			auto options = getPaintOptions(fabgl::PaintMode::Set, gpofg);
-			canvas->setPaintOptions(options);
+			setCanvasPaintOptions(options);
 		}
 		auto yPos = (compensateHeight && logicalCoords) ? (y + 1 - bitmap->height) : y;
 		if (bitmapTransform != 65535) {
@@ -846,6 +1522,7 @@ void Context::drawBitmap(uint16_t x, uint16_t y, bool compensateHeight, bool for
 					debug_log("drawBitmap: transform buffer %d is invalid\n\r", bitmapTransform);
 					bitmapTransform = 65535;
 					canvas->drawBitmap(x, yPos, bitmap.get());
+					markDirty(Rect(x, yPos, x + bitmap->width - 1, yPos + bitmap->height - 1));
 					return;
 				}
 				// NB: if we're drawing via PLOT and are using OS coords, then we _should_ be using bottom left of bitmap as our "origin" for transforms
@@ -855,11 +1532,14 @@ void Context::drawBitmap(uint16_t x, uint16_t y, bool compensateHeight, bool for
 
 				// we should have a valid transform buffer now, which includes an inverse chunk
 				canvas->drawTransformedBitmap(x, yPos, bitmap.get(), (float *)transformBuffer[0]->getBuffer(), (float *)transformBuffer[1]->getBuffer());
+				// transformed bounds aren't known here
+				markDirty(Rect(0, 0, canvasW - 1, canvasH - 1));
 				return;
 			}
 			// if buffer not found, we should fall back to normal drawing
 		}
 		canvas->drawBitmap(x, yPos, bitmap.get());
+		markDirty(Rect(x, yPos, x + bitmap->width - 1, yPos + bitmap->height - 1));
 	} else {
 		debug_log("drawBitmap: bitmap %d not found\n\r", currentBitmap);
 	}
@@ -880,9 +1560,9 @@ void Context::cls() {
 		activateSprites(0);
 	}
 	if (canvas) {
-		canvas->setPenColor(tfg);
-		canvas->setBrushColor(tbg);
-		canvas->setPaintOptions(tpo);
+		setCanvasPenColor(tfg);
+		setCanvasBrushColor(tbg);
+		setCanvasPaintOptions(tpo);
 		setClippingRect(textViewport);
 		clearViewport(ViewportType::Text);
 		plottingText = true;
@@ -895,9 +1575,9 @@ void Context::cls() {
 //
 void Context::clg() {
 	if (canvas) {
-		canvas->setPenColor(gfg);
-		canvas->setBrushColor(gbg);
-		canvas->setPaintOptions(gpobg);
+		setCanvasPenColor(gfg);
+		setCanvasBrushColor(gbg);
+		setCanvasPaintOptions(gpobg);
 		setClippingRect(graphicsViewport);
 		clearViewport(ViewportType::Graphics);
 		plottingText = false;
@@ -927,6 +1607,7 @@ void Context::resetGraphicsOptions() {
 	setCurrentBitmap(BUFFERED_BITMAP_BASEID);
 	setDottedLinePatternLength(0);
 	setAffineTransform(255, -1);
+	pathNonZero = false;
 }
 
 void Context::resetGraphicsPositioning() {
@@ -966,6 +1647,8 @@ void Context::reset() {
 //
 void Context::activate() {
 	plottingText = false;
+	// another context may have left the canvas in any state
+	invalidateCanvasState();
 	if (!ttxtMode) {
 		canvas->selectFont(font == nullptr ? &FONT_AGON : font.get());
 	}
@@ -175,9 +175,14 @@ void Context::setLogicalCoords(bool b) {
 
 // Scale a point, as appropriate for coordinate system
 //
+// Integer maths is used for each axis where it is known to match the scaling factors exactly
+//
 Point Context::scale(int16_t X, int16_t Y) {
 	if (logicalCoords) {
-		return Point((double)X / logicalScaleX, -(double)Y / logicalScaleY);
+		return Point(
+			logicalScaleExactX ? (X * canvasW) / LOGICAL_SCRW : (int)((double)X / logicalScaleX),
+			logicalScaleExactY ? -(Y * canvasH) / LOGICAL_SCRH : (int)(-(double)Y / logicalScaleY)
+		);
 	}
 	return Point(X, Y);
 }
@@ -187,7 +192,11 @@ Point Context::scale(int16_t X, int16_t Y) {
 Point Context::toCurrentCoordinates(int16_t X, int16_t Y) {
 	// if we're using logical coordinates then we need to scale and invert the Y axis
 	if (logicalCoords) {
-		return Point((double)X * logicalScaleX, (double)((canvasH - 1) - Y) * logicalScaleY);
+		int invertedY = (canvasH - 1) - Y;
+		return Point(
+			logicalScaleExactX ? (X * LOGICAL_SCRW) / canvasW : (int)((double)X * logicalScaleX),
+			logicalScaleExactY ? (invertedY * LOGICAL_SCRH) / canvasH : (int)((double)invertedY * logicalScaleY)
+		);
 	}
 
 	return Point(X, Y);
@@ -201,4 +210,26 @@ inline Point Context::toScreenCoordinates(int16_t X, int16_t Y) {
 	return Point(origin.X + p.X, origin.Y + p.Y);
 }
 
+// Convert an array of points from the currently active coordinate system to screen coordinates
+// The choice of coordinate system and scaling is made once for the whole array
+//
+void Context::toScreenCoordinates(const Point * points, Point * screenPoints, size_t count) {
+	if (!logicalCoords) {
+		for (size_t i = 0; i < count; i++) {
+			screenPoints[i] = Point(origin.X + points[i].X, origin.Y + points[i].Y);
+		}
+	} else if (logicalScaleExactX && logicalScaleExactY) {
+		for (size_t i = 0; i < count; i++) {
+			screenPoints[i] = Point(
+				origin.X + (points[i].X * canvasW) / LOGICAL_SCRW,
+				origin.Y - (points[i].Y * canvasH) / LOGICAL_SCRH
+			);
+		}
+	} else {
+		for (size_t i = 0; i < count; i++) {
+			screenPoints[i] = toScreenCoordinates(points[i].X, points[i].Y);
+		}
+	}
+}
+
 #endif // CONTEXT_VIEWPORT_H
@@ -0,0 +1,294 @@
+#ifndef SPRITE_COLLISIONS_H
+#define SPRITE_COLLISIONS_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <fabgl.h>
+
+#include "agon.h"
+#include "sprites.h"
+#include "types.h"
+
+// Sprite collision detection
+//
+// The broad phase is a uniform grid of cells over the screen. Sprites are binned into every cell they
+// overlap, and remember the rectangle they were binned with, so before each test only the sprites that
+// have moved, changed size, or been shown or hidden are re-binned.
+// The narrow phase compares 1bpp masks made from the alpha of each frame's bitmap.
+
+struct CollisionMask {
+	int16_t		width = 0;
+	int16_t		height = 0;
+	uint16_t	stride = 0;				// Bytes per mask row
+	std::vector<uint8_t, psram_allocator<uint8_t>> bits;	// MSB first, set where the bitmap is opaque
+};
+
+struct CollisionEntry {
+	Rect		rect;					// Screen area the sprite was binned with
+	bool		binned = false;
+};
+
+std::unordered_map<uint16_t, CollisionMask> collisionMasks;	// Masks by bitmap ID
+uint32_t		collisionMaskGeneration = 0;			// Bitmap generation the masks were made for
+std::vector<uint8_t> collisionCells[SPRITE_COLLISION_COLS * SPRITE_COLLISION_ROWS];
+CollisionEntry	collisionEntries[MAX_SPRITES];
+uint8_t			spriteCollisionGroups[MAX_SPRITES] = {};	// Group bitmask for each sprite
+uint32_t		collisionStamps[MAX_SPRITES] = {};		// Last query that visited each sprite, as sprites can be in several cells
+uint32_t		collisionQuery = 0;
+std::vector<uint8_t> collisionResults;					// Sprite IDs, or pairs of IDs, found by the last test
+
+void resetSpriteCollisions() {
+	for (auto &cell : collisionCells) {
+		cell.clear();
+	}
+	for (auto &entry : collisionEntries) {
+		entry.binned = false;
+	}
+	std::fill(std::begin(spriteCollisionGroups), std::end(spriteCollisionGroups), 0);
+	collisionMasks.clear();
+	collisionResults.clear();
+}
+
+// Drop the mask for a bitmap whose pixels have been changed in place, so it is rebuilt when next needed
+//
+inline void invalidateCollisionMask(uint16_t bitmapId) {
+	collisionMasks.erase(bitmapId);
+}
+
+inline void setSpriteCollisionGroups(uint8_t groups, uint8_t s = current_sprite) {
+	spriteCollisionGroups[s] = groups;
+}
+
+// Build the collision mask for a bitmap from its alpha channel
+//
+CollisionMask * getCollisionMask(uint16_t bitmapId) {
+	auto maskIter = collisionMasks.find(bitmapId);
+	if (maskIter != collisionMasks.end()) {
+		return &maskIter->second;
+	}
+	auto bitmap = getBitmap(bitmapId);
+	if (!bitmap) {
+		return nullptr;
+	}
+
+	CollisionMask mask;
+	mask.width = bitmap->width;
+	mask.height = bitmap->height;
+	mask.stride = (bitmap->width + 7) / 8;
+	mask.bits.resize(mask.stride * mask.height, 0);
+	auto data = bitmap->data;
+	switch (bitmap->format) {
+		case PixelFormat::Mask:
+			// already 1bpp with the same layout
+			std::copy(data, data + mask.bits.size(), mask.bits.begin());
+			break;
+		case PixelFormat::RGBA2222:
+		case PixelFormat::RGBA8888: {
+			auto is8888 = bitmap->format == PixelFormat::RGBA8888;
+			for (int y = 0; y < mask.height; y++) {
+				auto row = &mask.bits[y * mask.stride];
+				for (int x = 0; x < mask.width; x++) {
+					// alpha is the top two bits of an RGBA2222 pixel, or the fourth byte of RGBA8888
+					auto opaque = is8888 ? data[3] != 0 : (data[0] & 0xC0) != 0;
+					if (opaque) {
+						row[x >> 3] |= 0x80 >> (x & 7);
+					}
+					data += is8888 ? 4 : 1;
+				}
+			}
+		}	break;
+		default:
+			// other formats cannot be used as sprite frames, so treat the whole bitmap as solid
+			std::fill(mask.bits.begin(), mask.bits.end(), 0xFF);
+			break;
+	}
+	return &(collisionMasks[bitmapId] = std::move(mask));
+}
+
+// Returns the collision mask for a sprite's current frame
+//
+inline CollisionMask * getSpriteCollisionMask(uint8_t s) {
+	auto sprite = getSprite(s);
+	auto &frameUsers = spriteFrameUsers[s];
+	if (sprite->currentFrame < 0 || sprite->currentFrame >= (int)frameUsers.size()) {
+		return nullptr;
+	}
+	return getCollisionMask(frameUsers[sprite->currentFrame]->bitmapId);
+}
+
+inline bool isSpriteCollidable(uint8_t s) {
+	auto sprite = getSprite(s);
+	return s < numsprites && sprite->visible && sprite->framesCount > 0;
+}
+
+inline void getCollisionCells(const Rect &rect, int &col1, int &row1, int &col2, int &row2) {
+	col1 = std::clamp(rect.X1 >> SPRITE_COLLISION_CELL_SHIFT, 0, SPRITE_COLLISION_COLS - 1);
+	row1 = std::clamp(rect.Y1 >> SPRITE_COLLISION_CELL_SHIFT, 0, SPRITE_COLLISION_ROWS - 1);
+	col2 = std::clamp(rect.X2 >> SPRITE_COLLISION_CELL_SHIFT, 0, SPRITE_COLLISION_COLS - 1);
+	row2 = std::clamp(rect.Y2 >> SPRITE_COLLISION_CELL_SHIFT, 0, SPRITE_COLLISION_ROWS - 1);
+}
+
+void unbinSprite(uint8_t s) {
+	auto &entry = collisionEntries[s];
+	int col1, row1, col2, row2;
+	getCollisionCells(entry.rect, col1, row1, col2, row2);
+	for (int row = row1; row <= row2; row++) {
+		for (int col = col1; col <= col2; col++) {
+			auto &cell = collisionCells[row * SPRITE_COLLISION_COLS + col];
+			auto it = std::find(cell.begin(), cell.end(), s);
+			if (it != cell.end()) {
+				*it = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+	entry.binned = false;
+}
+
+void binSprite(uint8_t s, const Rect &rect) {
+	auto &entry = collisionEntries[s];
+	int col1, row1, col2, row2;
+	getCollisionCells(rect, col1, row1, col2, row2);
+	for (int row = row1; row <= row2; row++) {
+		for (int col = col1; col <= col2; col++) {
+			collisionCells[row * SPRITE_COLLISION_COLS + col].push_back(s);
+		}
+	}
+	entry.rect = rect;
+	entry.binned = true;
+}
+
+// Bring the grid up to date, re-binning only the sprites that have changed since the last test
+//
+void updateCollisionGrid() {
+	if (collisionMaskGeneration != bitmapGeneration) {
+		collisionMasks.clear();
+		collisionMaskGeneration = bitmapGeneration;
+	}
+	for (int s = 0; s < MAX_SPRITES; s++) {
+		auto &entry = collisionEntries[s];
+		if (!isSpriteCollidable(s)) {
+			if (entry.binned) {
+				unbinSprite(s);
+			}
+			continue;
+		}
+		auto sprite = getSprite(s);
+		Rect rect(sprite->x, sprite->y, sprite->x + sprite->getWidth() - 1, sprite->y + sprite->getHeight() - 1);
+		if (entry.binned) {
+			if (entry.rect.X1 == rect.X1 && entry.rect.Y1 == rect.Y1 && entry.rect.X2 == rect.X2 && entry.rect.Y2 == rect.Y2) {
+				continue;
+			}
+			unbinSprite(s);
+		}
+		binSprite(s, rect);
+	}
+}
+
+// Returns 32 mask bits starting at the given bit of a row, MSB first, reading zeros past the end of the row
+//
+inline uint32_t getMaskWord(const uint8_t * row, uint16_t stride, int bit) {
+	int byte = bit >> 3;
+	uint64_t value = 0;
+	for (int i = 0; i < 5; i++) {
+		value = (value << 8) | (byte + i < stride ? row[byte + i] : 0);
+	}
+	return value >> (8 - (bit & 7));
+}
+
+// Pixel-accurate test of two binned sprites whose rectangles overlap
+//
+bool spriteMasksOverlap(uint8_t a, uint8_t b) {
+	auto &rectA = collisionEntries[a].rect;
+	auto &rectB = collisionEntries[b].rect;
+	auto maskA = getSpriteCollisionMask(a);
+	auto maskB = getSpriteCollisionMask(b);
+	if (!maskA || !maskB) {
+		// no mask to compare, so rely on the bounding boxes
+		return true;
+	}
+	auto area = rectA.intersection(rectB);
+	for (int y = area.Y1; y <= area.Y2; y++) {
+		auto rowA = maskA->bits.data() + (y - rectA.Y1) * maskA->stride;
+		auto rowB = maskB->bits.data() + (y - rectB.Y1) * maskB->stride;
+		for (int x = area.X1; x <= area.X2; x += 32) {
+			auto count = std::min(32, area.X2 - x + 1);
+			uint32_t span = count == 32 ? 0xFFFFFFFF : ~(0xFFFFFFFF >> count);
+			auto bitsA = getMaskWord(rowA, maskA->stride, x - rectA.X1);
+			auto bitsB = getMaskWord(rowB, maskB->stride, x - rectB.X1);
+			if (bitsA & bitsB & span) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Call back for each sprite that shares a grid cell with sprite s and is in one of the given groups
+// (a groups mask of 0 means any sprite), and that collides with it
+//
+template<typename F>
+void forEachSpriteCollision(uint8_t s, uint8_t groups, F callback) {
+	auto &entry = collisionEntries[s];
+	int col1, row1, col2, row2;
+	getCollisionCells(entry.rect, col1, row1, col2, row2);
+	collisionQuery++;
+	for (int row = row1; row <= row2; row++) {
+		for (int col = col1; col <= col2; col++) {
+			for (auto other : collisionCells[row * SPRITE_COLLISION_COLS + col]) {
+				if (other == s || collisionStamps[other] == collisionQuery) {
+					continue;
+				}
+				collisionStamps[other] = collisionQuery;
+				if (groups && !(spriteCollisionGroups[other] & groups)) {
+					continue;
+				}
+				if (entry.rect.intersects(collisionEntries[other].rect) && spriteMasksOverlap(s, other)) {
+					callback(other);
+				}
+			}
+		}
+	}
+}
+
+// Find all the sprites colliding with sprite s, in ascending ID order
+// Results are left in collisionResults, and the count is returned
+//
+uint16_t testSpriteCollisions(uint8_t s) {
+	updateCollisionGrid();
+	collisionResults.clear();
+	if (!collisionEntries[s].binned) {
+		return 0;
+	}
+	forEachSpriteCollision(s, 0, [](uint8_t other) {
+		collisionResults.push_back(other);
+	});
+	std::sort(collisionResults.begin(), collisionResults.end());
+	return collisionResults.size();
+}
+
+// Find all colliding pairs of sprites with one sprite in groupsA and the other in groupsB
+// Results are left in collisionResults as pairs of IDs, A side first, and the pair count is returned
+//
+uint16_t testSpriteGroupCollisions(uint8_t groupsA, uint8_t groupsB) {
+	updateCollisionGrid();
+	collisionResults.clear();
+	for (int s = 0; s < MAX_SPRITES; s++) {
+		if (!collisionEntries[s].binned || !(spriteCollisionGroups[s] & groupsA)) {
+			continue;
+		}
+		auto inB = (spriteCollisionGroups[s] & groupsB) != 0;
+		forEachSpriteCollision(s, groupsB, [s, inB, groupsA](uint8_t other) {
+			// a pair that could be found from either side is only reported from the lower ID
+			if (inB && (spriteCollisionGroups[other] & groupsA) && other < s) {
+				return;
+			}
+			collisionResults.push_back(s);
+			collisionResults.push_back(other);
+		});
+	}
+	return collisionResults.size() / 2;
+}
+
+#endif // SPRITE_COLLISIONS_H
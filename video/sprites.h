@@ -20,10 +20,24 @@ uint8_t			numsprites = 0;					// Number of sprites on stage
 uint8_t			current_sprite = 0;				// Current sprite number
 Sprite			sprites[MAX_SPRITES];			// Sprite object storage
 
-// track which sprites may be using a bitmap
-std::unordered_map<uint16_t, std::vector<uint8_t, psram_allocator<uint8_t>>> bitmapUsers;
+uint32_t		bitmapGeneration = 1;			// Changed whenever bitmaps are created or removed, so resolved bitmap pointers can be checked
+
+// A sprite frame's bitmap ID, linked into the list of all sprite frames using that bitmap
+struct SpriteFrameUser {
+	uint16_t			bitmapId;
+	uint8_t				sprite;
+	SpriteFrameUser *	prev = nullptr;
+	SpriteFrameUser *	next = nullptr;
+};
+
+// bitmap ID for each frame of each sprite, held in step with the sprite's frames list
+std::vector<std::unique_ptr<SpriteFrameUser>> spriteFrameUsers[MAX_SPRITES];
+// head of the list of sprite frames using each bitmap
+std::unordered_map<uint16_t, SpriteFrameUser *> bitmapUsers;
 
 extern bool isVDPVariableSet(uint16_t flag);
+void refreshSprites();
+void clearSpriteFrames(uint8_t s);
 
 std::shared_ptr<Bitmap> getBitmap(uint16_t id) {
 	if (bitmaps.find(id) != bitmaps.end()) {
@@ -33,9 +47,51 @@ std::shared_ptr<Bitmap> getBitmap(uint16_t id) {
 }
 
 void resetBitmaps() {
-	bitmaps.clear();
-	// this will only be used after resetting sprites, so we can clear the bitmapUsers list
+	// sprites may still have frames, for instance when all buffers are cleared, so clear them
+	// before their bitmaps go, as clearBitmap would, which also empties the bitmapUsers list
+	bool refresh = false;
+	for (auto s = 0; s < MAX_SPRITES; s++) {
+		if (!spriteFrameUsers[s].empty()) {
+			refresh |= s < numsprites && sprites[s].visible;
+			clearSpriteFrames(s);
+		}
+	}
 	bitmapUsers.clear();
+	bitmaps.clear();
+	bitmapGeneration++;
+	if (refresh) {
+		refreshSprites();
+	}
+}
+
+// Link a sprite frame into the users list for a bitmap
+//
+void linkBitmapUser(SpriteFrameUser * user, uint16_t bitmapId) {
+	auto &head = bitmapUsers[bitmapId];
+	user->bitmapId = bitmapId;
+	user->prev = nullptr;
+	user->next = head;
+	if (head) {
+		head->prev = user;
+	}
+	head = user;
+}
+
+// Unlink a sprite frame from the users list of its bitmap
+//
+void unlinkBitmapUser(SpriteFrameUser * user) {
+	if (user->next) {
+		user->next->prev = user->prev;
+	}
+	if (user->prev) {
+		user->prev->next = user->next;
+	} else if (user->next) {
+		bitmapUsers[user->bitmapId] = user->next;
+	} else {
+		bitmapUsers.erase(user->bitmapId);
+	}
+	user->prev = nullptr;
+	user->next = nullptr;
 }
 
 Sprite * getSprite(uint8_t sprite = current_sprite) {
@@ -55,16 +111,11 @@ void clearSpriteFrames(uint8_t s = current_sprite) {
 	sprite->visible = false;
 	sprite->setFrame(0);
 	sprite->clearBitmaps();
-	// find all bitmaps used by this sprite and remove it from the list
-	for (auto bitmapUser : bitmapUsers) {
-		auto users = bitmapUser.second;
-		// remove all instances of this sprite from the users list
-		auto it = std::find(users.begin(), users.end(), s);
-		while (it != users.end()) {
-			users.erase(it);
-			it = std::find(users.begin(), users.end(), s);
-		}
+	// remove each of this sprite's frames from the users list of its bitmap
+	for (auto &user : spriteFrameUsers[s]) {
+		unlinkBitmapUser(user.get());
 	}
+	spriteFrameUsers[s].clear();
 }
 
 void clearBitmap(uint16_t b) {
@@ -72,15 +123,22 @@ void clearBitmap(uint16_t b) {
 		return;
 	}
 	bitmaps.erase(b);
+	bitmapGeneration++;
 
 	// find all sprites that had used this bitmap and clear their frames
-	if (bitmapUsers.find(b) != bitmapUsers.end()) {
-		auto users = bitmapUsers[b];
-		for (auto user : users) {
-			debug_log("clearBitmap: sprite %d can no longer use bitmap %d, so clearing sprite frames\n\r", user, b);
-			clearSpriteFrames(user);
-		}
-		bitmapUsers.erase(b);
+	// clearing a sprite unlinks all its frames, so take the list head afresh each time
+	bool refresh = false;
+	auto it = bitmapUsers.find(b);
+	while (it != bitmapUsers.end()) {
+		auto s = it->second->sprite;
+		debug_log("clearBitmap: sprite %d can no longer use bitmap %d, so clearing sprite frames\n\r", s, b);
+		refresh |= s < numsprites && getSprite(s)->visible;
+		clearSpriteFrames(s);
+		it = bitmapUsers.find(b);
+	}
+	// only sprites that were showing this bitmap need to be redrawn
+	if (refresh) {
+		refreshSprites();
 	}
 }
 
@@ -95,7 +153,14 @@ void addSpriteFrame(uint16_t bitmapId) {
 		debug_log("addSpriteFrame: bitmap %d is in native or unknown format and cannot be used as a sprite frame\n\r", bitmapId);
 		return;
 	}
-	bitmapUsers[bitmapId].push_back(current_sprite);
+	auto user = make_unique_psram<SpriteFrameUser>();
+	if (!user) {
+		debug_log("addSpriteFrame: failed to allocate frame for bitmap %d\n\r", bitmapId);
+		return;
+	}
+	user->sprite = current_sprite;
+	linkBitmapUser(user.get(), bitmapId);
+	spriteFrameUsers[current_sprite].push_back(std::move(user));
 	sprite->addBitmap(bitmap.get());
 	if (bitmap->format == PixelFormat::Mask) {
 		sprite->hardware = 0;
@@ -114,32 +179,18 @@ void replaceSpriteFrame(uint16_t bitmapId) {
 		return;
 	}
 
-	// remove one instance of current_sprite from the bitmapUsers list for the shown frame
-	// first step is to work out the bitmap ID of the current frame
-	auto frameBitmap = sprite->frames[sprite->currentFrame];
-	auto oldBitmapId = -1;
-	for (auto bitmap : bitmaps) {
-		if (bitmap.second.get() == frameBitmap) {
-			oldBitmapId = bitmap.first;
-			break;
-		}
+	auto &frameUsers = spriteFrameUsers[current_sprite];
+	if (sprite->currentFrame < 0 || sprite->currentFrame >= (int)frameUsers.size()) {
+		debug_log("replaceSpriteFrame: sprite %d has no frame to replace\n\r", current_sprite);
+		return;
 	}
 
-	// if we found the old bitmap, remove one entry of the sprite from the bitmapUsers list
-	if (oldBitmapId != -1) {
-		auto users = bitmapUsers[oldBitmapId];
-		for (auto user : users) {
-			// remove only one copy of current_sprite from the users list, if it exists
-			auto it = std::find(users.begin(), users.end(), current_sprite);
-			if (it != users.end()) {
-				users.erase(it);
-				break;
-			}
-		}
-	}
+	// move the shown frame from the users list of its old bitmap to the new one
+	auto user = frameUsers[sprite->currentFrame].get();
+	unlinkBitmapUser(user);
+	linkBitmapUser(user, bitmapId);
 
 	sprite->frames[sprite->currentFrame] = bitmap.get();
-	bitmapUsers[bitmapId].push_back(current_sprite);
 
 	if (bitmap->format == PixelFormat::Mask) {
 		sprite->hardware = 0;
@@ -7,6 +7,7 @@
 
 #include "agon.h"
 #include "agon_ps2.h"
+#include "agon_screen.h"
 #include "vdu_stream_processor.h"
 #include "vdp_protocol.h"
 
@@ -49,6 +50,24 @@ void setVDPVariable(uint16_t flag, uint16_t value) {
 			case VDPVAR_FREEPSRAM_HIGH:
 			case VDPVAR_BUFFERS_USED:
 				return;
+			case VDPVAR_CANVAS_SUPPRESSED_LOW:
+			case VDPVAR_CANVAS_SUPPRESSED_HIGH:
+				canvasStateSuppressed = 0;
+				return;
+			case VDPVAR_DIRTY_TRACKING:
+				setDirtyTracking(value > 2 ? 2 : value);
+				return;
+			case VDPVAR_DIRTY_BACKGROUND:
+				dirtyBackground = value;
+				return;
+			case VDPVAR_DIRTY_MERGES:
+				dirtyMerges = 0;
+				return;
+			case VDPVAR_DIRTY_RECTS:
+			case VDPVAR_DIRTY_RESTORED:
+			case VDPVAR_DIRTY_AREA_LOW:
+			case VDPVAR_DIRTY_AREA_HIGH:
+				return;
 
 			case VDPVAR_KEYBOARD_LAYOUT:
 				setKeyboardLayout(value);
@@ -321,6 +340,15 @@ bool isVDPVariableSet(uint16_t flag) {
 			case VDPVAR_FREEPSRAM_LOW:
 			case VDPVAR_FREEPSRAM_HIGH:
 			case VDPVAR_BUFFERS_USED:
+			case VDPVAR_CANVAS_SUPPRESSED_LOW:
+			case VDPVAR_CANVAS_SUPPRESSED_HIGH:
+			case VDPVAR_DIRTY_TRACKING:
+			case VDPVAR_DIRTY_BACKGROUND:
+			case VDPVAR_DIRTY_RECTS:
+			case VDPVAR_DIRTY_MERGES:
+			case VDPVAR_DIRTY_RESTORED:
+			case VDPVAR_DIRTY_AREA_LOW:
+			case VDPVAR_DIRTY_AREA_HIGH:
 			case VDPVAR_KEYBOARD_LAYOUT:
 			case VDPVAR_KEYBOARD_CTRL_KEYS:
 			case VDPVAR_KEYBOARD_REP_DELAY:
@@ -385,6 +413,24 @@ uint16_t getVDPVariable(uint16_t flag) {
 
 			case VDPVAR_BUFFERS_USED:
 				return buffers.size();
+			case VDPVAR_CANVAS_SUPPRESSED_LOW:
+				return canvasStateSuppressed & 0xFFFF;
+			case VDPVAR_CANVAS_SUPPRESSED_HIGH:
+				return canvasStateSuppressed >> 16;
+			case VDPVAR_DIRTY_TRACKING:
+				return dirtyTracking;
+			case VDPVAR_DIRTY_BACKGROUND:
+				return dirtyBackground;
+			case VDPVAR_DIRTY_RECTS:
+				return dirtyLists[dirtyBuffer].count;
+			case VDPVAR_DIRTY_MERGES:
+				return dirtyMerges;
+			case VDPVAR_DIRTY_RESTORED:
+				return dirtyRestored;
+			case VDPVAR_DIRTY_AREA_LOW:
+				return dirtyRestoredArea & 0xFFFF;
+			case VDPVAR_DIRTY_AREA_HIGH:
+				return dirtyRestoredArea >> 16;
 
 			case VDPVAR_KEYBOARD_LAYOUT:
 				return kbRegion;
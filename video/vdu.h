@@ -227,6 +227,16 @@ void VDUStreamProcessor::vdu_print(char c, bool usePeek) {
 			}
 		}
 	}
+	if (recordingList) {
+		for (size_t i = 0; i < s.size(); i++) {
+			if (!recordListEntry(DISPLAY_LIST_CHAR, s[i], 0, 0, 0)) {
+				// display list is full, so the rest of the string is printed
+				context->plotString(s.substr(i));
+				return;
+			}
+		}
+		return;
+	}
 	context->plotString(s);
 }
 
@@ -235,6 +245,9 @@ void VDUStreamProcessor::vdu_print(char c, bool usePeek) {
 void VDUStreamProcessor::vdu_colour() {
 	auto colour = readByte_t();
 
+	if (recordingList && recordListEntry(DISPLAY_LIST_COLOUR, 0, colour, 0, 0)) {
+		return;
+	}
 	context->setTextColour(colour);
 }
 
@@ -244,6 +257,9 @@ void VDUStreamProcessor::vdu_gcol() {
 	auto mode = readByte_t();
 	auto colour = readByte_t();
 
+	if (recordingList && recordListEntry(DISPLAY_LIST_GCOL, mode, colour, 0, 0)) {
+		return;
+	}
 	context->setGraphicsColour(mode, colour);
 }
 
@@ -358,6 +374,9 @@ void IRAM_ATTR VDUStreamProcessor::vdu_plot() {
 	auto x = readWord_t(); if (x == -1) return;
 	auto y = readWord_t(); if (y == -1) return;
 
+	if (recordingList && recordListEntry(DISPLAY_LIST_PLOT, command, 0, x, y)) {
+		return;
+	}
 	if (ttxtMode) return;
 
 	if (context->plot((int16_t) x, (int16_t) y, command)) {
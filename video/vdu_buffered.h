@@ -19,6 +19,7 @@
 #include "mem_helpers.h"
 #include "multi_buffer_stream.h"
 #include "sprites.h"
+#include "sprite_collisions.h"
 #include "vdp_variables.h"
 #include "types.h"
 #include "vdu_stream_processor.h"
@@ -230,6 +231,43 @@ void IRAM_ATTR VDUStreamProcessor::vdu_sys_buffered() {
 			}
 			bufferTransformData(bufferId, options, format, transformBufferId, sourceBufferId);
 		}	break;
+		case BUFFERED_PLOT: {
+			// VDU 23, 0, &A0, bufferId; &2A, options, command, format, [offset;[offsetHighByte, [blockIndex;]]] [stride;] [limit;] : Plot coordinates from a buffer
+			auto options = readByte_t(); if (options == -1) return;
+			auto command = readByte_t(); if (command == -1) return;
+			auto format = readByte_t(); if (format == -1) return;
+			bufferPlot(bufferId, options, command, format);
+		}	break;
+		case BUFFERED_RECORD_LIST: {
+			// VDU 23, 0, &A0, bufferId; &2B : Start recording a display list
+			bufferRecordList(bufferId);
+		}	break;
+		case BUFFERED_END_LIST: {
+			// VDU 23, 0, &A0, bufferId; &2C : Stop recording a display list
+			bufferEndList();
+		}	break;
+		case BUFFERED_REPLAY_LIST: {
+			// VDU 23, 0, &A0, bufferId; &2D, offsetX; offsetY; : Replay a display list
+			auto offsetX = readWord_t(); if (offsetX == -1) return;
+			auto offsetY = readWord_t(); if (offsetY == -1) return;
+			bufferReplayList(bufferId, offsetX, offsetY);
+		}	break;
+		case BUFFERED_PATCH_LIST: {
+			// VDU 23, 0, &A0, bufferId; &2E, index; flags, [x; y;] [colour] : Patch a display list entry
+			auto index = readWord_t(); if (index == -1) return;
+			auto flags = readByte_t(); if (flags == -1) return;
+			int32_t x = 0;
+			int32_t y = 0;
+			int16_t colour = 0;
+			if (flags & PATCH_LIST_COORDS) {
+				x = readWord_t(); if (x == -1) return;
+				y = readWord_t(); if (y == -1) return;
+			}
+			if (flags & PATCH_LIST_COLOUR) {
+				colour = readByte_t(); if (colour == -1) return;
+			}
+			bufferPatchList(bufferId, index, flags, x, y, colour);
+		}	break;
 		case BUFFERED_READ_VARIABLE: {
 			// VDU 23, 0, &A0, bufferId; &30, flags, offset; variableId; [default[;]]
 			bufferReadVariable(bufferId);
@@ -391,6 +429,17 @@ void VDUStreamProcessor::bufferRemoveUsers(uint16_t bufferId) {
 	clearMouseCursor(bufferId);
 }
 
+// Called when a buffer's contents are changed in place
+// Fonts and bitmaps made from a buffer use its memory directly, so anything derived from them is discarded
+//
+void VDUStreamProcessor::bufferContentsChanged(uint16_t bufferId) {
+	if (fonts.find(bufferId) != fonts.end()) {
+		// advance widths and the glyph index are rebuilt from the new data
+		invalidateGlyphIndex();
+	}
+	invalidateCollisionMask(bufferId);
+}
+
 // VDU 23, 0, &A0, bufferId; 2: Clear buffer
 // Removes all streams stored against the given bufferId
 // sending a bufferId of 65535 (i.e. -1) clears all buffers
@@ -407,6 +456,7 @@ void VDUStreamProcessor::bufferClear(uint16_t bufferId) {
 		context->resetCharToBitmap();
 		resetFonts();
 		resetSamples();
+		resetListRecording();
 		return;
 	}
 	auto bufferIter = buffers.find(bufferId);
@@ -890,6 +940,7 @@ void VDUStreamProcessor::bufferAdjust(uint16_t adjustBufferId) {
 		return;
 	}
 	auto &buffer = bufferIter->second;
+	bufferContentsChanged(bufferId);
 
 	if (command == -1 || count == -1 || offset.blockOffset == -1 || operandOffset.blockOffset == -1) {
 		debug_log("bufferAdjust: invalid command, count, offset or operand value\n\r");
@@ -1480,6 +1531,7 @@ void VDUStreamProcessor::bufferReverse(uint16_t bufferId, uint8_t options) {
 	}
 
 	debug_log("bufferReverse: reversing buffer %d, value size %d, chunk size %d\n\r", bufferId, valueSize, chunkSize);
+	bufferContentsChanged(bufferId);
 
 	for (const auto &block : buffer) {
 		if (chunkSize == 0) {
@@ -2364,6 +2416,261 @@ void VDUStreamProcessor::bufferTransformData(uint16_t bufferId, uint8_t options,
 	debug_log("bufferTransformData: copied %d streams into buffer %d (%d)\n\r", streams.size(), bufferId, buffers[bufferId].size());
 }
 
+// VDU 23, 0, &A0, bufferId; &2A, options, command, format, [offset;[offsetHighByte, [blockIndex;]]] [stride;] [limit;]
+// Plot a series of coordinates from a buffer, each using the given PLOT command
+// Coordinates are X, Y pairs of values in the given format, as used for transform data,
+// so a format of &C0 indicates 16-bit integers, and transformed data can be plotted directly
+// If the "has colour" option is set each pair is followed by GCOL mode and colour bytes
+// Stride defaults to the size of a coordinate pair (including colour bytes)
+// A coordinate pair must not span over buffer block boundaries
+//
+void VDUStreamProcessor::bufferPlot(uint16_t bufferId, uint8_t options, uint8_t command, uint8_t format) {
+	bool hasColour = options & PLOT_BUFFER_HAS_COLOUR;
+	bool hasOffset = options & PLOT_BUFFER_HAS_OFFSET;
+	bool hasStride = options & PLOT_BUFFER_HAS_STRIDE;
+	bool hasLimit = options & PLOT_BUFFER_HAS_LIMIT;
+	bool advancedOffsets = options & PLOT_BUFFER_ADVANCED;
+
+	AdvancedOffset offset = {};
+	uint32_t stride = 0;
+	uint32_t limit = 0;
+	if (hasOffset) {
+		offset = getOffsetFromStream(advancedOffsets);
+		if (offset.blockOffset == -1) return;
+	}
+	if (hasStride) {
+		stride = readWord_t();
+		if (stride == -1) return;
+	}
+	if (hasLimit) {
+		limit = readWord_t();
+		if (limit == -1) return;
+	}
+	if (limit == 0) {	// limit of 0 means plot all the data
+		limit = 0xFFFFFFFF;
+	}
+
+	if (ttxtMode) return;
+
+	auto bufferIter = buffers.find(bufferId);
+	if (bufferIter == buffers.end()) {
+		debug_log("bufferPlot: buffer %d not found\n\r", bufferId);
+		return;
+	}
+	auto &buffer = bufferIter->second;
+
+	bool isFixed, is16Bit;
+	int8_t shift;
+	extractFormatInfo(format, isFixed, is16Bit, shift);
+	auto bytesPerValue = is16Bit ? 2 : 4;
+	auto pairSize = (bytesPerValue * 2) + (hasColour ? 2 : 0);
+	if (stride == 0) {
+		stride = pairSize;
+	}
+
+	// absolute coordinates are read in batches, to be converted to screen coordinates together
+	bool absolute = (command & 0x07) >= 4;
+	Point points[PLOT_BUFFER_BATCH];
+	Point screenPoints[PLOT_BUFFER_BATCH];
+	uint8_t colours[PLOT_BUFFER_BATCH][2];
+	bool pending = false;
+	while (limit) {
+		size_t count = 0;
+		while (limit && count < PLOT_BUFFER_BATCH) {
+			auto span = getBufferSpan(buffer, offset, pairSize);
+			if (span.empty()) {
+				limit = 0;
+				break;
+			}
+			limit--;
+			uint32_t rawX = 0;
+			uint32_t rawY = 0;
+			memcpy(&rawX, span.data(), bytesPerValue);
+			memcpy(&rawY, span.data() + bytesPerValue, bytesPerValue);
+			auto x = convertValueToFloat(rawX, is16Bit, isFixed, shift);
+			auto y = convertValueToFloat(rawY, is16Bit, isFixed, shift);
+			points[count] = Point((int16_t) lroundf(x), (int16_t) lroundf(y));
+			if (hasColour) {
+				colours[count][0] = span[bytesPerValue * 2];
+				colours[count][1] = span[bytesPerValue * 2 + 1];
+			}
+			offset.blockOffset += stride;
+			count++;
+		}
+		if (absolute) {
+			context->toScreenCoordinates(points, screenPoints, count);
+		}
+		for (size_t i = 0; i < count; i++) {
+			if (hasColour) {
+				context->setGraphicsColour(colours[i][0], colours[i][1]);
+			}
+			if (absolute) {
+				pending = context->plot(points[i], screenPoints[i], command);
+			} else {
+				pending = context->plot(points[i].X, points[i].Y, command);
+			}
+		}
+	}
+	if (pending) {
+		// a path may be continued by a subsequent plot command
+		context->plotPending(peekByte_t(FAST_COMMS_TIMEOUT));
+	}
+}
+
+// VDU 23, 0, &A0, bufferId; &2B
+// Start recording a display list into a buffer
+// Whilst recording, PLOT, COLOUR, GCOL, printed characters and bitmap select and draw
+// commands are stored as pre-decoded entries rather than being executed
+//
+void VDUStreamProcessor::bufferRecordList(uint16_t bufferId) {
+	if (bufferId == 65535) {
+		debug_log("bufferRecordList: invalid buffer ID\n\r");
+		return;
+	}
+	recordingList = true;
+	recordingListId = bufferId;
+	recordedList.clear();
+	debug_log("bufferRecordList: recording display list into buffer %d\n\r", bufferId);
+}
+
+// VDU 23, 0, &A0, bufferId; &2C
+// Stop recording, replacing the contents of the recording buffer with the display list
+//
+void VDUStreamProcessor::bufferEndList() {
+	if (!recordingList) {
+		return;
+	}
+	recordingList = false;
+	bufferClear(recordingListId);
+	auto size = recordedList.size() * sizeof(DisplayListEntry);
+	if (size > 0) {
+		auto bufferStream = bufferCreate(recordingListId, size);
+		if (!bufferStream) {
+			debug_log("bufferEndList: failed to create buffer %d\n\r", recordingListId);
+		} else {
+			bufferStream->writeBuffer((uint8_t *)recordedList.data(), size, 0);
+		}
+	}
+	debug_log("bufferEndList: recorded %d entries into buffer %d\n\r", recordedList.size(), recordingListId);
+	recordedList.clear();
+	recordedList.shrink_to_fit();
+}
+
+// Record an entry into the display list being recorded
+// If the list is full, recording is ended and false is returned so the caller carries out the command instead
+//
+bool VDUStreamProcessor::recordListEntry(uint8_t type, uint8_t command, uint8_t colour, int16_t x, int16_t y) {
+	if (recordedList.size() >= MAX_DISPLAY_LIST_ENTRIES) {
+		debug_log("recordListEntry: display list for buffer %d is full, ending recording\n\r", recordingListId);
+		bufferEndList();
+		return false;
+	}
+	recordedList.push_back({ type, command, colour, 0, x, y });
+	return true;
+}
+
+// Abandon any display list being recorded, so graphics output is no longer swallowed
+// Called on mode change and when all buffers are cleared
+//
+void VDUStreamProcessor::resetListRecording() {
+	recordingList = false;
+	recordingListId = 65535;
+	recordedList.clear();
+	recordedList.shrink_to_fit();
+}
+
+// VDU 23, 0, &A0, bufferId; &2D, offsetX; offsetY;
+// Replay a display list, offsetting absolute plot and bitmap coordinates
+// If a display list is being recorded, the entries are appended to it instead
+//
+void VDUStreamProcessor::bufferReplayList(uint16_t bufferId, int16_t offsetX, int16_t offsetY) {
+	auto bufferIter = buffers.find(bufferId);
+	if (bufferIter == buffers.end()) {
+		debug_log("bufferReplayList: buffer %d not found\n\r", bufferId);
+		return;
+	}
+	auto &buffer = bufferIter->second;
+	AdvancedOffset offset = {};
+	DisplayListEntry entry;
+	std::string text;
+	bool pending = false;
+
+	auto next = [&]() {
+		auto span = getBufferSpan(buffer, offset, sizeof(DisplayListEntry));
+		if (span.empty()) {
+			return false;
+		}
+		memcpy(&entry, span.data(), sizeof(DisplayListEntry));
+		offset.blockOffset += sizeof(DisplayListEntry);
+		if (entry.type == DISPLAY_LIST_BITMAP_DRAW || (entry.type == DISPLAY_LIST_PLOT && (entry.command & 0x04))) {
+			entry.x += offsetX;
+			entry.y += offsetY;
+		}
+		return true;
+	};
+
+	bool more = next();
+	while (more) {
+		if (recordingList && recordListEntry(entry.type, entry.command, entry.colour, entry.x, entry.y)) {
+			more = next();
+			continue;
+		}
+		switch (entry.type) {
+			case DISPLAY_LIST_PLOT:
+				if (!ttxtMode) {
+					pending = context->plot(entry.x, entry.y, entry.command);
+				}
+				break;
+			case DISPLAY_LIST_COLOUR:
+				context->setTextColour(entry.colour);
+				break;
+			case DISPLAY_LIST_GCOL:
+				context->setGraphicsColour(entry.command, entry.colour);
+				break;
+			case DISPLAY_LIST_CHAR:
+				text += (char)entry.command;
+				break;
+			case DISPLAY_LIST_BITMAP_SELECT:
+				context->setCurrentBitmap((uint16_t)entry.x);
+				break;
+			case DISPLAY_LIST_BITMAP_DRAW:
+				context->drawBitmap(entry.x, entry.y, false, true);
+				break;
+		}
+		more = next();
+		if (!text.empty() && (!more || entry.type != DISPLAY_LIST_CHAR)) {
+			// runs of characters are printed together
+			context->plotString(text);
+			text.clear();
+		}
+		if (pending && (!more || entry.type != DISPLAY_LIST_PLOT)) {
+			// a path is only continued by another plot entry
+			context->plotPending(-1);
+			pending = false;
+		}
+	}
+}
+
+// VDU 23, 0, &A0, bufferId; &2E, index; flags, [x; y;] [colour]
+// Change the coordinates and/or colour of entry N of a display list in place
+//
+void VDUStreamProcessor::bufferPatchList(uint16_t bufferId, uint16_t index, uint8_t flags, int16_t x, int16_t y, uint8_t colour) {
+	AdvancedOffset offset = { (uint32_t)index * sizeof(DisplayListEntry), 0 };
+	auto span = getBufferSpan(bufferId, offset, sizeof(DisplayListEntry));
+	if (span.empty()) {
+		debug_log("bufferPatchList: entry %d not found in buffer %d\n\r", index, bufferId);
+		return;
+	}
+	auto entry = (DisplayListEntry *)span.data();
+	if (flags & PATCH_LIST_COORDS) {
+		entry->x = x;
+		entry->y = y;
+	}
+	if (flags & PATCH_LIST_COLOUR) {
+		entry->colour = colour;
+	}
+}
+
 // VDU 23, 0, &A0, bufferId; &30, options, offset; variableId; [default[;]]
 // Copy a VDP Variable value into a buffer at a given offset
 //
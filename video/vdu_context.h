@@ -80,11 +80,10 @@ void VDUStreamProcessor::selectContext(uint8_t id) {
 		context->activate();
 	} else {
 		debug_log("selectContext: creating new context %d\n\r", id);
-		// copy current stack
-		auto newStack = make_shared_psram<ContextVector>();
-		for (auto it = contextStack->begin(); it != contextStack->end(); ++it) {
-			newStack->push_back(make_shared_psram<Context>(*it->get()));
-		}
+		// copy current stack, sharing saved contexts with it
+		// so only the top context, which will be changed, needs copying now
+		auto newStack = make_shared_psram<ContextVector>(*contextStack);
+		newStack->back() = make_shared_psram<Context>(*newStack->back());
 		contextStacks[id] = newStack;
 		contextStack = contextStacks[id];
 		context = contextStack->back();
@@ -144,7 +143,7 @@ void VDUStreamProcessor::restoreContext() {
 	if (contextStack->size() > 1) {
 		debug_log("restoreContext: restoring context\n\r");
 		contextStack->pop_back();
-		context = contextStack->back();
+		unshareTopContext();
 		context->activate();
 	} else {
 		debug_log("restoreContext: no context to restore\n\r");
@@ -172,12 +171,24 @@ void VDUStreamProcessor::restoreAllContexts() {
 		context = contextStack->front();
 		contextStack->clear();
 		contextStack->push_back(context);
+		unshareTopContext();
 		context->activate();
 	} else {
 		debug_log("restoreAllContexts: no contexts to restore\n\r");
 	}
 }
 
+// Make the top context of the current stack active, copying it first if another stack shares it
+//
+void VDUStreamProcessor::unshareTopContext() {
+	auto &top = contextStack->back();
+	// references from this stack and from the active context pointer don't count as sharing
+	if (top.use_count() > (top == context ? 2 : 1)) {
+		top = make_shared_psram<Context>(*top);
+	}
+	context = top;
+}
+
 void VDUStreamProcessor::clearContextStack() {
 	debug_log("clearContextStack: clearing all contexts\n\r");
 	contextStack->clear();
@@ -194,6 +205,8 @@ void VDUStreamProcessor::resetAllContexts() {
 	contextStacks[0] = contextStack;
 	// perform a "mode" style reset
 	resetContext(0);
+	// a display list left recording would otherwise swallow all graphics output
+	resetListRecording();
 }
 
 #endif // VDU_CONTEXT_H
@@ -22,7 +22,8 @@ void VDUStreamProcessor::vdu_sys_font() {
         } break;
         case FONT_FROM_BUFFER: {
             // VDU 23, 0, &95, 1, bufferId; width, height, ascent, flags  - Load font from buffer
-            // maybe add on chptrbuffer at the end? for var-width fonts??
+            // for variable width fonts (flags bit 0 set) the buffer holds 256 glyphs back to back,
+            // each being a width byte followed by its rows, and a width of 0 uses the widest glyph
             auto bufferId = readWord_t(); if (bufferId == -1) return;
             auto width = readByte_t(); if (width == -1) return;
             auto height = readByte_t(); if (height == -1) return;
@@ -75,6 +76,17 @@ void VDUStreamProcessor::vdu_sys_font() {
             fontCopy->pointSize = FONT_AGON.pointSize;
             sendModeInformation();
         } break;
+        case FONT_FROM_CONTAINER: {
+            // VDU 23, 0, &95, 6, bufferId; flags  - Load font from a font container in a buffer
+            // with FONT_SELECTFLAG_SELECT set the font is selected once loaded, using the other flags as for FONT_SELECT
+            auto bufferId = readWord_t(); if (bufferId == -1) return;
+            auto flags = readByte_t(); if (flags == -1) return;
+            auto font = createFontFromContainer(bufferId);
+            if (font && (flags & FONT_SELECTFLAG_SELECT)) {
+                context->changeFont(bufferId, flags & ~FONT_SELECTFLAG_SELECT);
+            }
+            sendModeInformation();
+        } break;
         case FONT_SELECT_BY_NAME: {
             // VDU 23, 0, &95, &10, <ZeroTerminatedString>  - Select font by name
             debug_log("fontSelectByName: not yet implemented\n\r");
@@ -10,11 +10,13 @@
 // #include "vdu_layers.h"
 // in vdu_sys.h and is called by VDUStreamProcessor::vdu_sys_video()
 
+#include "buffers.h"
+#include "compression.h"
 #include "vdu_stream_processor.h"
 
 #define VDP_LAYER_TILEBANK_INIT				0x00		// VDU 23,0,194,0
 #define VDP_LAYER_TILEBANK_LOAD				0x01		// VDU 23,0,194,1
-#define VDP_LAYER_TILEBANK_LOAD_BUFFER		0x02		// VDU 23,0,194,2	[Future]
+#define VDP_LAYER_TILEBANK_LOAD_BUFFER		0x02		// VDU 23,0,194,2
 #define VDP_LAYER_TILEBANK_DRAW				0x06		// VDU 23,0,194,6
 #define VDP_LAYER_TILEBANK_FREE				0x07		// VDU 23,0,194,7
 #define VDP_LAYER_TILEPALETTE_INIT			0x08		// VDU 23,0,194,8	[Future]
@@ -24,7 +26,8 @@
 #define VDP_LAYER_TILEPALETTE_FREE			0x0F		// VDU 23,0,194,15 	[Future]
 #define VDP_LAYER_TILEMAP_INIT				0x10		// VDU 23,0,194,16
 #define VDP_LAYER_TILEMAP_SET_TILE			0x11		// VDU 23,0,194,17
-#define VDP_LAYER_TILEMAP_SET_MULTIPLE		0x12		// VDU 23,0,194,18	[Future]
+#define VDP_LAYER_TILEMAP_SET_MULTIPLE		0x12		// VDU 23,0,194,18
+#define VDP_LAYER_TILEMAP_LOAD_BUFFER		0x13		// VDU 23,0,194,19
 #define VDP_LAYER_TILEMAP_FREE				0x17		// VDU 23,0,194,23
 #define VDP_LAYER_TILELAYER_INIT			0x18		// VDU 23,0,194,24
 #define VDP_LAYER_TILELAYER_SET_PROPERTY	0x19		// VDU 23,0,194,25
@@ -37,10 +40,66 @@
 #define VDP_LAYER_TILELAYER_DRAW				0x1E		// VDU 23,0,194,30
 #define VDP_LAYER_TILELAYER_FREE				0x1F		// VDU 23,0,194,31
 
+// Options for VDP_LAYER_TILEBANK_LOAD_BUFFER
+#define VDP_LAYER_TILEBANK_LOAD_RGBA8888	0x01		// Buffer holds RGBA8888 pixels, to be converted to RGBA2222
+#define VDP_LAYER_TILEBANK_LOAD_COMPRESSED	0x02		// Buffer is compressed
+
 // Begin: Function Prototypes for internal Tile Engine use
 void debug_log_mem(void);
 // End: Function Prototypes for internal Tile Engine use
 
+// Writes tile data into a tile bank, converting RGBA8888 pixels to the bank's RGBA2222 format when needed
+
+struct TileBankWriter {
+	uint8_t * dest;				// Start of the first tile to write
+	uint32_t count = 0;			// Bytes written to the bank
+	uint32_t limit = 0;			// Bytes that can be written
+	bool rgba8888 = false;		// Source pixels are RGBA8888
+	uint8_t pixel[4];			// RGBA8888 pixel being gathered
+	uint8_t pixelBytes = 0;
+
+	inline bool full() const {
+		return count >= limit;
+	}
+
+	inline bool write(uint8_t value) {
+		if (full()) return false;
+		if (!rgba8888) {
+			dest[count++] = value;
+			return true;
+		}
+		pixel[pixelBytes++] = value;
+		if (pixelBytes == 4) {
+			dest[count++] = (pixel[0] >> 6) | ((pixel[1] >> 6) << 2) | ((pixel[2] >> 6) << 4) | ((pixel[3] >> 6) << 6);
+			pixelBytes = 0;
+		}
+		return true;
+	}
+
+	// Write a run of bytes, returning false once the tiles are full
+	bool write(const uint8_t * data, uint32_t length) {
+		if (!rgba8888) {
+			uint32_t n = std::min(length, limit - count);
+			memcpy(dest + count, data, n);
+			count += n;
+			return !full();
+		}
+		while (length--) {
+			if (!write(*data++)) return false;
+		}
+		return !full();
+	}
+};
+
+static bool tilebank_write_decompressed_byte(void * p_dd, uint8_t orig_data) {
+	DecompressionData* dd = (DecompressionData*) p_dd;
+	if (dd->output_count >= dd->orig_size) {
+		return false;
+	}
+	dd->output_count++;
+	return ((TileBankWriter*) dd->context)->write(orig_data);
+}
+
 void VDUStreamProcessor::vdu_sys_layers(void) {
 
 	auto cmd = readByte_t();
@@ -75,6 +134,18 @@ void VDUStreamProcessor::vdu_sys_layers(void) {
 
 		case VDP_LAYER_TILEBANK_LOAD_BUFFER: {
 
+			// VDU 23,0,194,2,<tileBankNum>,<tileId>,<bufferId>;<tileCount>,<options>
+			// tileCount of 0 loads as many tiles as the buffer holds
+			// options bit 0 = buffer holds RGBA8888 pixels, bit 1 = buffer is compressed
+
+			uint8_t tileBankNum = readByte_t();			// 0-3
+			uint8_t tileId = readByte_t();				// 0-255
+			uint16_t bufferId = readWord_t();
+			uint8_t tileCount = readByte_t();			// 0-255
+			uint8_t options = readByte_t();
+
+			vdu_sys_layers_tilebank_load_buffer(tileBankNum, tileId, bufferId, tileCount, options);
+
 		} break;
 
 		case VDP_LAYER_TILEBANK_DRAW: {
@@ -136,6 +207,34 @@ void VDUStreamProcessor::vdu_sys_layers(void) {
 
 		case VDP_LAYER_TILEMAP_SET_MULTIPLE: {
 
+			// VDU 23,0,194,18,<tilelayernumber>,<xpos>,<ypos>,<width>,<height>,[<tileid>,<tileattribute>]*
+			// Followed by width*height tile id/attribute pairs, row by row
+
+			uint8_t tileLayerNum = readByte_t();
+			uint8_t xPos = readByte_t();
+			uint8_t yPos = readByte_t();
+			uint8_t width = readByte_t();
+			uint8_t height = readByte_t();
+
+			vdu_sys_layers_tilemap_set_multiple(tileLayerNum, xPos, yPos, width, height);
+
+		} break;
+
+		case VDP_LAYER_TILEMAP_LOAD_BUFFER: {
+
+			// VDU 23,0,194,19,<tilelayernumber>,<xpos>,<ypos>,<width>,<height>,<bufferId>;
+			// Buffer holds width*height tile id/attribute pairs, row by row
+			// A width or height of 0 extends the region to the edge of the tile map
+
+			uint8_t tileLayerNum = readByte_t();
+			uint8_t xPos = readByte_t();
+			uint8_t yPos = readByte_t();
+			uint8_t width = readByte_t();
+			uint8_t height = readByte_t();
+			uint16_t bufferId = readWord_t();
+
+			vdu_sys_layers_tilemap_load_buffer(tileLayerNum, xPos, yPos, width, height, bufferId);
+
 		} break;
 
 		case VDP_LAYER_TILEMAP_FREE: {
@@ -169,6 +268,17 @@ void VDUStreamProcessor::vdu_sys_layers(void) {
 
 		case VDP_LAYER_TILELAYER_SET_PROPERTY: {
 
+			// VDU 23,0,194,25,<tileLayerNum>,<property>,<value>
+			//
+			// property is one of:
+			// 0 = background colour, 1 = transparent colour, 2 = priority (draw order when composited, lowest first)
+
+			uint8_t tileLayerNum = readByte_t();
+			uint8_t property = readByte_t();
+			uint8_t value = readByte_t();
+
+			vdu_sys_layers_tilelayer_set_property(tileLayerNum, property, value);
+
 		} break;
 
 		case VDP_LAYER_TILELAYER_SET_SCROLL: {
@@ -213,6 +323,7 @@ void VDUStreamProcessor::vdu_sys_layers(void) {
 		case VDP_LAYER_TILELAYER_DRAW: {
 
 			// VDU 23,0,194,30,<tileLayerNum>
+			// A tileLayerNum of 255 draws all layers composited together
 
 			uint8_t tileLayerNum = readByte_t();
 
@@ -334,6 +445,8 @@ void VDUStreamProcessor::vdu_sys_layers_tilebank_init(uint8_t tileBankNum, uint8
 		}
 	}
 
+	vdu_sys_layers_tilelayer_invalidate();
+
 	debug_log("In vdu_sys_layers_tilebank_init: After memory allocation\n\r");
 	debug_log_mem();
 }
@@ -389,6 +502,83 @@ void VDUStreamProcessor::vdu_sys_layers_tilebank_load(uint8_t tileBankNum, uint8
 		destPixel = (tileId * 64) + n;
 		tileBankPtr[destPixel]= sourcePixel;
 	}
+
+	vdu_sys_layers_tilelayer_invalidate();
+}
+
+void VDUStreamProcessor::vdu_sys_layers_tilebank_load_buffer(uint8_t tileBankNum, uint8_t tileId, uint16_t bufferId, uint8_t tileCount, uint8_t options) {
+
+	/*
+		Loads tiles from a buffer into a tile bank, starting at tileId, without any per-byte protocol overhead.
+		- Uncompressed RGBA2222 data is copied into the bank one buffer block at a time.
+		- RGBA8888 data is converted to the bank's RGBA2222 format as it is copied.
+		- Compressed buffers are decompressed straight into the bank, converting on the way if needed.
+		A tileCount of 0 loads as many tiles as the buffer holds, up to the end of the bank.
+	*/
+
+	uint8_t * tileBankPtr = getTileBankPtr(tileBankNum);
+
+	if (tileBankPtr == NULL) {
+		debug_log("vdu_sys_layers_tilebank_load_buffer: Invalid tilebank %d specified or tilebank not initialised.\r\n",tileBankNum);
+		return;
+	}
+
+	auto bufferIter = buffers.find(bufferId);
+	if (bufferIter == buffers.end()) {
+		debug_log("vdu_sys_layers_tilebank_load_buffer: Buffer %d not found.\r\n",bufferId);
+		return;
+	}
+	auto &buffer = bufferIter->second;
+
+	uint32_t maxTiles = 256 - tileId;
+	uint32_t tilesWanted = (tileCount == 0 || tileCount > maxTiles) ? maxTiles : tileCount;
+
+	TileBankWriter writer;
+	writer.dest = tileBankPtr + (tileId * 64);
+	writer.limit = tilesWanted * 64;
+	writer.rgba8888 = (options & VDP_LAYER_TILEBANK_LOAD_RGBA8888) != 0;
+
+	if (options & VDP_LAYER_TILEBANK_LOAD_COMPRESSED) {
+
+		// Validate the compression header
+
+		if (buffer.empty() || buffer[0]->size() < sizeof(CompressionFileHeader)) {
+			debug_log("vdu_sys_layers_tilebank_load_buffer: Buffer %d too small for compression header.\r\n",bufferId);
+			return;
+		}
+
+		auto p_hdr = (const CompressionFileHeader*) buffer[0]->getBuffer();
+		if (p_hdr->marker[0] != 'C' ||
+			p_hdr->marker[1] != 'm' ||
+			p_hdr->marker[2] != 'p' ||
+			p_hdr->type != COMPRESSION_TYPE_TURBO) {
+			debug_log("vdu_sys_layers_tilebank_load_buffer: Buffer %d compression header is invalid.\r\n",bufferId);
+			return;
+		}
+
+		DecompressionData dd;
+		agon_init_decompression(&dd, &writer, &tilebank_write_decompressed_byte, p_hdr->orig_size);
+
+		uint32_t skip_hdr = sizeof(CompressionFileHeader);
+		for (const auto &block : buffer) {
+			auto p_data = block->getBuffer() + skip_hdr;
+			auto bufferLength = block->size() - skip_hdr;
+			skip_hdr = 0;
+			while (bufferLength-- && !writer.full()) {
+				agon_decompress_byte(&dd, *p_data++);
+			}
+		}
+
+	} else {
+
+		for (const auto &block : buffer) {
+			if (!writer.write(block->getBuffer(), block->size())) break;
+		}
+	}
+
+	debug_log("vdu_sys_layers_tilebank_load_buffer: Loaded %d bytes into tile bank %d from tile %d.\r\n", writer.count, tileBankNum, tileId);
+
+	vdu_sys_layers_tilelayer_invalidate();
 }
 
 void VDUStreamProcessor::vdu_sys_layers_tilebank_draw(uint8_t tileBankNum, uint8_t tileId, uint8_t palette, uint8_t xPos, uint8_t yPos, uint8_t xOffset, uint8_t yOffset, uint8_t tileAttribute) {
@@ -507,6 +697,8 @@ void VDUStreamProcessor::vdu_sys_layers_tilebank_free(uint8_t tileBankNum) {
 		}
 	}
 
+	vdu_sys_layers_tilelayer_invalidate();
+
 	debug_log("In vdu_sys_layers_tilebank_free: After memory free call\r\n");
 	debug_log_mem();
 }
@@ -516,196 +708,214 @@ void VDUStreamProcessor::vdu_sys_layers_tilemap_init(uint8_t tileLayerNum, uint8
 	debug_log("In vdu_sys_layers_tilemap_init: Before memory allocation\n\r");
 	debug_log_mem();
 
-	// Check if tileMap0 already exists and free if it is.
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilemap_init: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-	switch (tileLayerNum) {
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-		case 0: {		// If tilemap/layer number is 0
-			
-			// Check if already exists
-	
-			if (tileMap0 != NULL) {
-				// If already exists, then free and reinitialise
+	// Check if the tile map already exists
 
-				vdu_sys_layers_tilemap_free(tileLayerNum); 
-			}
-			
-		} break;
+	if (tileLayer.tileMap != NULL) {
+		// If already exists, then free and reinitialise
 
-		default: {
-			debug_log("vdu_sys_layers_tilemap_init: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
-			return;
-		}
+		vdu_sys_layers_tilemap_free(tileLayerNum); 
 	}
 
 	//	The following tile map sizes are supported:
 	//	0=32x32, 1=32x64, 2=32x128, 3=64x32, 4=64x64, 5=64x128, 6=128x32, 7=128x64, 8=128x128
 
-	switch (tileMapSize) {
+	if (tileMapSize > 8) {
+		debug_log("vdu_sys_layers_tilemap_init: Invalid tileMapSize %d specified.\r\n",tileMapSize);
+		return;
+	}
 
-		case 0: {		// 32x32 tilemap
-			
-			tileMap0Properties.width = 32;
-			tileMap0Properties.height = 32;
+	tileLayer.tileMapProperties.width = 32 << (tileMapSize / 3);
+	tileLayer.tileMapProperties.height = 32 << (tileMapSize % 3);
 
-		} break;
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
 
-		case 1: {		// 32x64 tilemap
-			
-			tileMap0Properties.width = 32;
-			tileMap0Properties.height = 64;
+	// The tile map is a single row-major allocation, so rows are read sequentially when rendering
+	int tileMapBufferSize = tileMapWidth * tileMapHeight * sizeof(uint16_t);
 
-		} break;
+	tileLayer.tileMap = (uint16_t *)heap_caps_malloc(tileMapBufferSize,MALLOC_CAP_SPIRAM);
 
-		case 2: {		// 32x128 tilemap
-			
-			tileMap0Properties.width = 32;
-			tileMap0Properties.height = 128;
+	if (tileLayer.tileMap != NULL) {
 
-		} break;
+		// Set every entry in the tile map to 0
+		memset(tileLayer.tileMap, 0, tileMapBufferSize);
 
-		case 3: {		// 64x32 tilemap
-			
-			tileMap0Properties.width = 64;
-			tileMap0Properties.height = 32;
+		tileLayer.ringValid = false;
 
-		} break;
+	} else {
+		debug_log("vdu_sys_layers_tilemap_init: Failed to allocate memory for tile map %d.\r\n",tileLayerNum);
+	}
 
-		case 4: {		// 64x64 tilemap
-			
-			tileMap0Properties.width = 64;
-			tileMap0Properties.height = 64;
+	debug_log("In vdu_sys_layers_tilemap_init: After memory allocation\n\r");
+	debug_log_mem();
+}
 
-		} break;
+void VDUStreamProcessor::vdu_sys_layers_tilemap_set(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t tileId, uint8_t tileAttribute) {
+	
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilemap_set: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-		case 5: {		// 64x128 tilemap
-			
-			tileMap0Properties.width = 64;
-			tileMap0Properties.height = 128;
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-		} break;
+	if (tileLayer.tileMap != NULL) {
+		// Skip if passed x and y are greater than the size of the tilemap
+		if (xPos >= tileLayer.tileMapProperties.width || yPos >= tileLayer.tileMapProperties.height) return;
 
-		case 6: {		// 128x32 tilemap
-			
-			tileMap0Properties.width = 128;
-			tileMap0Properties.height = 32;
+		tileLayer.tileMap[(yPos * tileLayer.tileMapProperties.width) + xPos] = packTile(tileId, tileAttribute);
 
-		} break;
+		vdu_sys_layers_tilemap_mark_dirty(tileLayerNum, xPos, yPos, 1, 1);
+	}
+}
 
-		case 7: {		// 128x64 tilemap
-			
-			tileMap0Properties.width = 128;
-			tileMap0Properties.height = 64;
+void VDUStreamProcessor::vdu_sys_layers_tilemap_set_multiple(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height) {
 
-		} break;
+	/*
+		Sets a rectangular region of the tile map from width*height tile id/attribute pairs that follow
+		the command. All of the pairs are always read, so that the stream stays in step, but only the
+		tiles that fall within the tile map are stored.
+	*/
 
-		case 8: {		// 128x128 tilemap
-			
-			tileMap0Properties.width = 128;
-			tileMap0Properties.height = 128;
+	TileLayer * tileLayer = tileLayerNum < TILE_LAYERS ? &tileLayers[tileLayerNum] : NULL;
 
-		} break;
+	if (tileLayer == NULL || tileLayer->tileMap == NULL) {
+		debug_log("vdu_sys_layers_tilemap_set_multiple: Invalid tileLayerNum %d specified or tile map not initialised.\r\n",tileLayerNum);
+	}
 
-		default: {
-			debug_log("vdu_sys_layers_tilemap_init: Invalid tileMapSize %d specified.\r\n",tileMapSize);
-			return;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint8_t tileId = readByte_t();
+			uint8_t tileAttribute = readByte_t();
+
+			if (tileLayer == NULL || tileLayer->tileMap == NULL) continue;
+			if (xPos + x >= tileLayer->tileMapProperties.width || yPos + y >= tileLayer->tileMapProperties.height) continue;
+
+			tileLayer->tileMap[((yPos + y) * tileLayer->tileMapProperties.width) + xPos + x] = packTile(tileId, tileAttribute);
 		}
 	}
 
-	uint8_t tileMapWidth = tileMap0Properties.width;
-	uint8_t tileMapHeight = tileMap0Properties.height;
+	if (tileLayer != NULL && tileLayer->tileMap != NULL) {
+		vdu_sys_layers_tilemap_mark_dirty(tileLayerNum, xPos, yPos, width, height);
+	}
+}
 
-	int tileMapBufferSize = tileMapWidth * sizeof(struct Tile*);
+void VDUStreamProcessor::vdu_sys_layers_tilemap_load_buffer(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height, uint16_t bufferId) {
 
-	bool tileMapMemoryAllocation = false;			// Flag to check memory allocation status. Default to false (i.e., not allocated).
+	/*
+		Fills a rectangular region of the tile map from a buffer of tile id/attribute pairs, row by row.
+		A pair has the same layout as a packed tile map entry (id in the low byte, attribute in the high
+		byte), so each row is copied straight into the map, a buffer block at a time.
+		Rows or columns of the region that fall outside the tile map are skipped.
+	*/
 
-	// Initial release to only support a single tile layer
-	if (tileLayerNum != 0) {
-		debug_log("vdu_sys_layers_tilemap_init: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilemap_load_buffer: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
 		return;
 	}
 
-	switch (tileLayerNum) {
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-		case 0: {		// If tile map number is 0
-						
-			// Allocate memory wide enough for each column in the tile map
-			tileMap0 = (struct Tile**)heap_caps_malloc(tileMapBufferSize,MALLOC_CAP_SPIRAM);
+	if (tileLayer.tileMap == NULL) {
+		debug_log("vdu_sys_layers_tilemap_load_buffer: Tile map %d not initialised.\r\n",tileLayerNum);
+		return;
+	}
 
-			// If memory allocation for the width of the tilemap was a success, then allocate memory for each column in the tilemap
+	auto bufferIter = buffers.find(bufferId);
+	if (bufferIter == buffers.end()) {
+		debug_log("vdu_sys_layers_tilemap_load_buffer: Buffer %d not found.\r\n",bufferId);
+		return;
+	}
+	auto &buffer = bufferIter->second;
 
-			if (tileMap0 != NULL) {
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
 
-				// If tileMap0 is not null, then the memory has been successfully allocated
+	if (xPos >= tileMapWidth || yPos >= tileMapHeight) return;
 
-				tileMapMemoryAllocation = true;
+	if (width == 0) width = tileMapWidth - xPos;
+	if (height == 0) height = tileMapHeight - yPos;
 
-				// As memory allocation was successful for the width of the tilemap, now allocate a column for each row
+	// Only the part of each row inside the tile map is copied
 
-				for (auto i=0; i<tileMapWidth; i++) {
-					tileMap0[i] = (struct Tile*)heap_caps_malloc(tileMapHeight * sizeof(struct Tile),MALLOC_CAP_SPIRAM);
+	uint32_t copyBytes = std::min<int>(width, tileMapWidth - xPos) * sizeof(uint16_t);
+	uint32_t skipBytes = (width * sizeof(uint16_t)) - copyBytes;
+	int rows = std::min<int>(height, tileMapHeight - yPos);
 
-					// Check that the memory allocation for the row is successful
-					if (tileMap0[i] == NULL) {
-						debug_log("vdu_sys_layers_tilemap_init: Failed to allocate memory for tileMap0[%d].\r\n",tileMap0[i]);
-						tileMapMemoryAllocation = false;
-					}
-				}
-			} else {
-				debug_log("vdu_sys_layers_tilemap_init: Failed to allocate memory for tileMap0.\r\n");
-				
-				tileMapMemoryAllocation = false;
-				
-			}
+	AdvancedOffset offset = {};
 
-			// Check that memory allocation was successful. If not, then clean up. If successful, then set contents to 0.
+	for (int y = 0; y < rows; y++) {
+		uint8_t * dest = (uint8_t *)&tileLayer.tileMap[((yPos + y) * tileMapWidth) + xPos];
+		uint32_t remaining = copyBytes;
 
-			if (tileMapMemoryAllocation == false) {
+		while (remaining > 0) {
+			auto span = getBufferSpan(buffer, offset);
+			if (span.empty()) {
+				// Ran out of buffer, so keep what has been copied so far
+				debug_log("vdu_sys_layers_tilemap_load_buffer: Buffer %d too small for region.\r\n",bufferId);
+				vdu_sys_layers_tilemap_mark_dirty(tileLayerNum, xPos, yPos, width, y + 1);
+				return;
+			}
+			uint32_t n = std::min<uint32_t>(span.size(), remaining);
+			memcpy(dest, span.data(), n);
+			dest += n;
+			remaining -= n;
+			offset.blockOffset += n;
+		}
+		offset.blockOffset += skipBytes;
+	}
 
-				// Tidy up by calling free...
+	vdu_sys_layers_tilemap_mark_dirty(tileLayerNum, xPos, yPos, width, rows);
+}
 
-				vdu_sys_layers_tilemap_free(tileLayerNum);
+void VDUStreamProcessor::vdu_sys_layers_tilemap_mark_dirty(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height) {
 
-			} else {
+	// Mark each ring cell showing a tile in the given region of the tile map for re-rendering. The ring
+	// can be wider or taller than the tile map, in which case a tile is shown more than once.
 
-				// Only continue if the init was successful...
-			
-				// Set every byte in the tile map to 0
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-				for (auto i=0; i<tileMapWidth; i++) {
-					for (auto j=0; j<tileMapHeight; j++) {
-						tileMap0[i][j].id = 0;
-						tileMap0[i][j].attribute = 0 ;
-					}
-				}
+	if (!tileLayer.ringValid) return;
 
-			}
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
 
-		} break;
-	}
+	if (xPos >= tileMapWidth || yPos >= tileMapHeight) return;
 
-	debug_log("In vdu_sys_layers_tilemap_init: After memory allocation\n\r");
-	debug_log_mem();
-}
+	int ringWidth = tileLayer.width + 1;
+	int ringHeight = tileLayer.height + 1;
 
-void VDUStreamProcessor::vdu_sys_layers_tilemap_set(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t tileId, uint8_t tileAttribute) {
-	
-	switch (tileLayerNum) {
-		case 0: {
-			if (tileMap0 != NULL) {
-				// Skip if passed x and y are greater than the size of the tilemap
-				if (xPos >= tileMap0Properties.width || yPos >= tileMap0Properties.height) return;
+	width = std::min<int>(width, tileMapWidth - xPos);
+	height = std::min<int>(height, tileMapHeight - yPos);
+
+	if (tileLayer.dirtyTiles.size() + (width * height) > TILE_LAYER_DIRTY_MAX) {
+		// Too many changes to track, so render the whole layer again
+		tileLayer.dirtyTiles.clear();
+		tileLayer.ringValid = false;
+		return;
+	}
 
-				if (tileMap0 != NULL) {
-					tileMap0[xPos][yPos].id = tileId;
-					tileMap0[xPos][yPos].attribute = tileAttribute;
+	for (int y = yPos; y < yPos + height; y++) {
+		for (int x = xPos; x < xPos + width; x++) {
+			for (auto column = (x - tileLayer.renderedXPos + tileMapWidth) % tileMapWidth; column < ringWidth; column += tileMapWidth) {
+				for (auto row = (y - tileLayer.renderedYPos + tileMapHeight) % tileMapHeight; row < ringHeight; row += tileMapHeight) {
+					if (tileLayer.dirtyTiles.size() >= TILE_LAYER_DIRTY_MAX) {
+						tileLayer.dirtyTiles.clear();
+						tileLayer.ringValid = false;
+						return;
+					}
+					int ringColumn = (tileLayer.ringX + column) % ringWidth;
+					int ringRow = (tileLayer.ringY + row) % ringHeight;
+					tileLayer.dirtyTiles.push_back((ringRow * ringWidth) + ringColumn);
 				}
 			}
-		} break;
-
-		default: {
-			debug_log("vdu_sys_layers_tilemap_set: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
-			return;
 		}
 	}
 }
@@ -715,35 +925,26 @@ void VDUStreamProcessor::vdu_sys_layers_tilemap_free(uint8_t tileLayerNum) {
 	debug_log("In vdu_sys_layers_tilemap_free: Before memory free call.\r\n");
 	debug_log_mem();
 
-	switch (tileLayerNum) {
-		case 0: {
-
-			uint8_t tileMapWidth = tileMap0Properties.width;
-
-			if (tileMap0 != NULL) {
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilemap_free: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-				debug_log("vdu_sys_layers_tilemap_free: Freeing tileMap0.\r\n");
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-				for (auto i=0; i<tileMapWidth; i++) {
+	if (tileLayer.tileMap != NULL) {
 
-					// For each column in the tilemap, free the memory if allocated
-					if (tileMap0[i] != NULL) {
-						heap_caps_free(tileMap0[i]);
-					}
-				}
-				heap_caps_free(tileMap0);
+		debug_log("vdu_sys_layers_tilemap_free: Freeing tile map %d.\r\n", tileLayerNum);
 
-				tileMap0 = NULL;
+		heap_caps_free(tileLayer.tileMap);
 
-			} else {
-				debug_log("vdu_sys_layers_tilemap_free: Tile Map %d memory not allocated.\r\n", tileLayerNum);
-			}
-		} break;
+		tileLayer.tileMap = NULL;
+		tileLayer.ringValid = false;
+		tileCompositeValid = false;
 
-		default: {
-			debug_log("vdu_sys_layers_tilemap_free: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
-		}
-	}	
+	} else {
+		debug_log("vdu_sys_layers_tilemap_free: Tile Map %d memory not allocated.\r\n", tileLayerNum);
+	}
 
 	debug_log("In vdu_sys_layers_tilemap_free: After memory free call.\r\n");
 	debug_log_mem();	
@@ -793,168 +994,168 @@ void VDUStreamProcessor::vdu_sys_layers_tilelayer_init(uint8_t tileLayerNum, uin
 		}
 	}
 
-	switch (tileLayerNum) {
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_init: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-		case 0: {		// Tile Layer 0
-			
-			tileLayer0.height = tileLayerHeight;
-			tileLayer0.width = tileLayerWidth;
-			tileLayer0.sourceXPos = 0;
-			tileLayer0.sourceYPos = 0;
-			tileLayer0.xOffset = 0;
-			tileLayer0.yOffset = 0;
-			tileLayer0.attribute = 0;
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-			if (tileLayer0Buffer != NULL) {
+	tileLayer.height = tileLayerHeight;
+	tileLayer.width = tileLayerWidth;
+	tileLayer.sourceXPos = 0;
+	tileLayer.sourceYPos = 0;
+	tileLayer.xOffset = 0;
+	tileLayer.yOffset = 0;
+	tileLayer.attribute = 0;
 
-				// If already exists, then free and reallocate
-				vdu_sys_layers_tilelayer_free(tileLayerNum);
-			}
+	if (tileLayer.buffer != NULL || tileLayer.ringBuffer != NULL) {
 
-			int tileLayer0BufferSize = ((tileLayerHeight + 1) * 8) * ((tileLayerWidth + 1) * 8);
-			// int tileLayer0BufferSize = ((tileLayerHeight) * 8) * ((tileLayerWidth) * 8);
+		// If already exists, then free and reallocate
+		vdu_sys_layers_tilelayer_free(tileLayerNum);
+	}
 
-			debug_log("In vdu_sys_layers_tilelayer_init: tileLayerHeight: %d tileLayerWidth: %d\r\n", tileLayerHeight, tileLayerWidth);
-			debug_log("In vdu_sys_layers_tilelayer_init: tileLayer0BufferSize: %dbytes (%dK)\r\n", tileLayer0BufferSize, tileLayer0BufferSize / 1024);
+	// The ring holds one more row and column of tiles than the layer, for the partly shown tiles when scrolled
+	int tileLayerRingSize = ((tileLayerHeight + 1) * 8) * ((tileLayerWidth + 1) * 8);
+	int tileLayerBufferSize = (tileLayerHeight * 8) * (tileLayerWidth * 8);
 
-			tileLayer0Buffer = heap_caps_malloc(tileLayer0BufferSize,MALLOC_CAP_SPIRAM);
+	debug_log("In vdu_sys_layers_tilelayer_init: tileLayerHeight: %d tileLayerWidth: %d\r\n", tileLayerHeight, tileLayerWidth);
+	debug_log("In vdu_sys_layers_tilelayer_init: tileLayerBufferSize: %dbytes (%dK), tileLayerRingSize: %dbytes (%dK)\r\n", tileLayerBufferSize, tileLayerBufferSize / 1024, tileLayerRingSize, tileLayerRingSize / 1024);
 
+	tileLayer.buffer = heap_caps_malloc(tileLayerBufferSize,MALLOC_CAP_SPIRAM);
+	tileLayer.ringBuffer = heap_caps_malloc(tileLayerRingSize,MALLOC_CAP_SPIRAM);
 
-			// Log the allocated memory
+	if (tileLayer.buffer != NULL && tileLayer.ringBuffer != NULL) {
 
+		// Cast the void pointers to integers
+		tileLayer.bufferPtr = (uint8_t *)tileLayer.buffer;
+		tileLayer.ringPtr = (uint8_t *)tileLayer.ringBuffer;
+		tileLayer.ringValid = false;
+		tileLayer.outputValid = false;
+		tileLayer.dirtyTiles.clear();
+		tileCompositeValid = false;
 
-			if (tileLayer0Buffer != nullptr) {
-				size_t actualSize = heap_caps_get_allocated_size(tileLayer0Buffer);
-				debug_log("Allocated size: %zu bytes\r\n", actualSize);
-			} else {
-				debug_log("Memory allocation failed\r\n");
-			}
+		// Set every byte in the layer buffer to the background colour of the layer (default 0 = transparent)
+		memset(tileLayer.bufferPtr, tileLayer.backgroundColour, tileLayerBufferSize);
 
-			debug_log("In vdu_sys_layers_tilelayer_init: tileLayer0Buffer starting address: %d\r\n", &tileLayer0Buffer);
+		tileLayer.bitmap = Bitmap(tileLayerWidth * 8, tileLayerHeight * 8, tileLayer.buffer, PixelFormat::RGBA2222);
 
-			if (tileLayer0Buffer != NULL) {
+		tileLayer.init = 1;		// Set as initialised
+	}
+	else {
+		debug_log("vdu_sys_layers_tilelayer_init: Memory allocation failed\r\n");
+		vdu_sys_layers_tilelayer_free(tileLayerNum);
+	}
 
-				// Cast the void pointer to an integer
-				tileLayer0Ptr = (uint8_t *)tileLayer0Buffer;
+	debug_log("In vdu_sys_layers_tilelayer_init: After memory allocation\n\r");
+	debug_log_mem();
+}
 
-				// Set every byte in the tile bank to the background colour of the layer (default 0 = transparent)
-				for (auto i=0; i <tileLayer0BufferSize; i++)
-					tileLayer0Ptr[i] = tileLayer0.backgroundColour; 
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_set_property(uint8_t tileLayerNum, uint8_t property, uint8_t value) {
 
-				tileLayer0Bitmap = Bitmap(tileLayerWidth * 8, tileLayerHeight * 8, tileLayer0Buffer, PixelFormat::RGBA2222);
-			}
-			else {
-				// Something went wrong. Calll the free function to clear up the memory
-				vdu_sys_layers_tilelayer_free(tileLayerNum);
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_set_property: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
+
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
+
+	switch (property) {
+		case TILE_LAYER_PROP_BACKGROUND: {
+			if (tileLayer.backgroundColour != value) {
+				// The background shows in every empty cell and transparent tile pixel, so render the whole layer again
+				tileLayer.backgroundColour = value;
+				tileLayer.dirtyTiles.clear();
+				tileLayer.ringValid = false;
 			}
+		} break;
 
-			tileLayer0init = 1;		// Set as initialised
+		case TILE_LAYER_PROP_TRANSPARENT: {
+			tileLayer.transparentColour = value;
+			tileCompositeValid = false;
+		} break;
 
+		case TILE_LAYER_PROP_PRIORITY: {
+			tileLayer.priority = value;
+			tileCompositeValid = false;
 		} break;
 
 		default: {
-			debug_log("vdu_sys_layers_tilelayer_init: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
-			return;
+			debug_log("vdu_sys_layers_tilelayer_set_property: Invalid property %d specified.\r\n",property);
 		}
-
 	}
-
-	debug_log("In vdu_sys_layers_tilelayer_init: After memory allocation\n\r");
-	debug_log_mem();
 }
 
 void VDUStreamProcessor::vdu_sys_layers_tilelayer_set_scroll(uint8_t tileLayerNum, uint8_t xPos, uint8_t yPos, uint8_t xOffset, uint8_t yOffset) {
 
-	switch (tileLayerNum) {
-		
-		case 0: {
-
-			if (tileLayer0init != 0) {		// Only continue if the tile layer is initialised
-				if (tileMap0 != NULL) {		// Only continue if the tile map is initialised
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_set_scroll: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-					uint8_t tileMapWidth = tileMap0Properties.width;
-					uint8_t tileMapHeight = tileMap0Properties.height;
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-					if (xPos >= tileMapWidth) { xPos = 0; }
-					if (yPos >= tileMapHeight) { yPos = 0; }
+	if (tileLayer.init == 0) {		// Only continue if the tile layer is initialised
+		debug_log("vdu_sys_layers_tilelayer_set_scroll: tileLayer %d is not initialised.\r\n", tileLayerNum);
+		return;
+	}
+	if (tileLayer.tileMap == NULL) {		// Only continue if the tile map is initialised
+		debug_log("vdu_sys_layers_tilelayer_set_scroll: tileMap %d is not initialised.\r\n", tileLayerNum);
+		return;
+	}
 
-					if (xOffset > 7) { xOffset = 0; }
-					if (yOffset > 7) { yOffset = 0;	}
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
 
-					tileLayer0.sourceXPos = xPos;
-					tileLayer0.sourceYPos = yPos;
-					tileLayer0.xOffset = xOffset;
-					tileLayer0.yOffset = yOffset;
-				} else {
-					debug_log("vdu_sys_layers_tilelayer_set_scroll: tileMap0 is not initialised.\r\n");
-					return;
-				}
-			} else {
-				debug_log("vdu_sys_layers_tilelayer_set_scroll: tileLayer is not initialised.\r\n");
-				return;
-			}
+	if (xPos >= tileMapWidth) { xPos = 0; }
+	if (yPos >= tileMapHeight) { yPos = 0; }
 
-		} break;
+	if (xOffset > 7) { xOffset = 0; }
+	if (yOffset > 7) { yOffset = 0;	}
 
-		default: {
-			debug_log("vdu_sys_layers_tilelayer_set_scroll: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
-			return;
-		}
-	}
+	tileLayer.sourceXPos = xPos;
+	tileLayer.sourceYPos = yPos;
+	tileLayer.xOffset = xOffset;
+	tileLayer.yOffset = yOffset;
 }
 
 void VDUStreamProcessor::vdu_sys_layers_tilelayer_update_layerbuffer(uint8_t tileLayerNum) {
 
-	uint8_t xPos;
-	uint8_t yPos;
-	uint8_t tileId;
-	uint8_t tileAttribute;
-	uint8_t tileLayerHeight;
-	uint8_t tileLayerWidth;
-	uint8_t sourceXPos;
-	uint8_t sourceYPos;
-	uint8_t xOffset;
-	uint8_t yOffset;
-	uint8_t tileMapWidth;
-	uint8_t tileMapHeight;
-
-	switch (tileLayerNum) {
+	/*
+		The layer's tiles are rendered into a ring one tile wider and taller than the layer. The ring's origin
+		(ringX, ringY) is the ring cell holding the tile at the layer's scroll position, and wraps around.
 
-		case 0: {
-
-			if (tileLayer0init != 0) {
-				if (tileMap0 != NULL) {
-
-					tileLayerHeight = tileLayer0.height;
-					tileLayerWidth = tileLayer0.width;
-
-					sourceXPos = tileLayer0.sourceXPos;
-					sourceYPos = tileLayer0.sourceYPos;
+		- Scrolling by whole tiles moves the origin, and only the newly exposed columns and rows are rendered.
+		- Tiles changed in the tile map while shown in the ring are re-rendered individually.
+		- The sub-tile offsets are applied when the visible area is copied from the ring into the layer buffer,
+		  which is skipped altogether when nothing has changed.
+	*/
 
-					xOffset = tileLayer0.xOffset;
-					yOffset = tileLayer0.yOffset;
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_renderlayer: Invalid tileLayerNum: %d\r\n",tileLayerNum);
+		return;
+	}
 
-					tileMapWidth = tileMap0Properties.width;
-					tileMapHeight = tileMap0Properties.height;
-				} else {
-					debug_log("vdu_sys_layers_tilelayer_renderlayer: tileMap0 is not initialised.\r\n");
-					return;
-				}
-			} else {
-				debug_log ("vdu_sys_layers_tilelayer_renderlayer: tileLayer0 is not initialised.\r\n");
-				return;
-			}
-		} break;
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-		default: {
-			debug_log("vdu_sys_layers_tilelayer_renderlayer: Invalid tileLayerNum: %d\r\n",tileLayerNum);
-			return;
-		}
+	if (tileLayer.init == 0) {
+		debug_log ("vdu_sys_layers_tilelayer_renderlayer: tileLayer %d is not initialised.\r\n", tileLayerNum);
+		return;
+	}
+	if (tileLayer.tileMap == NULL) {
+		debug_log("vdu_sys_layers_tilelayer_renderlayer: tileMap %d is not initialised.\r\n", tileLayerNum);
+		return;
 	}
 
-	int layerBufferWidth = tileLayerWidth * 8;
-	int layerBufferHeight = tileLayerHeight * 8;
-	int layerDataBufferSize = layerBufferWidth * layerBufferHeight;
+	uint8_t sourceXPos = tileLayer.sourceXPos;
+	uint8_t sourceYPos = tileLayer.sourceYPos;
+	uint8_t xOffset = tileLayer.xOffset;
+	uint8_t yOffset = tileLayer.yOffset;
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
+
+	int ringWidth = tileLayer.width + 1;
+	int ringHeight = tileLayer.height + 1;
 
 	// Perform validation checks
 
@@ -967,1051 +1168,407 @@ void VDUStreamProcessor::vdu_sys_layers_tilelayer_update_layerbuffer(uint8_t til
 		return;
 	}
 
-	// Clear Row Buffer - move this up...
-	
-		for (auto i=0; i<layerDataBufferSize; i++) {
-			tileLayer0Ptr[i] = 0;				// Setting to 0 is transparent. Future: Layer BG Colour setting.
-	}
-
-	// Process rows for each frame
-
-	for (auto y=0; y<=tileLayerHeight; y++) {
-
-		// Process tile map for current row
+	if (tileLayer.ringValid) {
 
-		yPos = y;
+		// Work out how far the layer has scrolled in whole tiles, taking the shorter way around the tile map
 
-		for (auto x=0; x<=tileLayerWidth; x++) {
-																
-			// read the Tile Map
-			tileId = tileMap0[sourceXPos][sourceYPos].id;
-			tileAttribute = tileMap0[sourceXPos][sourceYPos].attribute;
+		int xScroll = (sourceXPos - tileLayer.renderedXPos + tileMapWidth) % tileMapWidth;
+		int yScroll = (sourceYPos - tileLayer.renderedYPos + tileMapHeight) % tileMapHeight;
+		if (xScroll > tileMapWidth / 2) { xScroll -= tileMapWidth; }
+		if (yScroll > tileMapHeight / 2) { yScroll -= tileMapHeight; }
 
-			xPos = x;	
+		if (abs(xScroll) >= ringWidth || abs(yScroll) >= ringHeight) {
 
-			if (tileId == 0) {		// Tile 0 is special...
+			// Scrolled too far for any of the ring to be reused
+			tileLayer.ringValid = false;
 
-				// What you do here depends on the tile attribute in "special" mode:
+		} else if (xScroll != 0 || yScroll != 0) {
 
-				switch (tileAttribute) {
+			tileLayer.ringX = (tileLayer.ringX + xScroll + ringWidth) % ringWidth;
+			tileLayer.ringY = (tileLayer.ringY + yScroll + ringHeight) % ringHeight;
+			tileLayer.renderedXPos = sourceXPos;
+			tileLayer.renderedYPos = sourceYPos;
 
-					case 0: {		// Tile is transparent and not drawn
+			// Render the newly exposed columns, which are at the right when scrolling right and the left when scrolling left
 
-					} break;
+			for (auto i=0; i<abs(xScroll); i++) {
+				int column = (tileLayer.ringX + (xScroll > 0 ? ringWidth - xScroll + i : i)) % ringWidth;
+				for (auto row=0; row<ringHeight; row++) {
+					renderTileLayerCell(tileLayerNum, column, row);
 				}
+			}
 
-			} else {				// Tile is normal and should be processed accordingly
+			// Render the newly exposed rows likewise
 
-				// Check attribute to get the tile bank number (from bits 2 and 3)
+			for (auto i=0; i<abs(yScroll); i++) {
+				int row = (tileLayer.ringY + (yScroll > 0 ? ringHeight - yScroll + i : i)) % ringHeight;
+				for (auto column=0; column<ringWidth; column++) {
+					renderTileLayerCell(tileLayerNum, column, row);
+				}
+			}
 
-				uint8_t tileBankNum = (tileAttribute & 0x0C) >> 2;
+			tileLayer.outputValid = false;
+		}
+	}
 
-				// Check attribute to get tile draw direction (from bits 0 and 1) and call appropriate draw function
+	if (!tileLayer.ringValid) {
 
-				uint8_t tileFlip = tileAttribute & 0x03;
+		// Render every tile, with the ring origin reset to the top left
 
-				switch (tileFlip) {
-					case 0x00:		// Normal drawing
-						writeTileToLayerBuffer(tileBankNum, tileId, xPos, xOffset, yPos, yOffset, tileLayer0Ptr, tileLayerHeight, tileLayerWidth);
-						break;
-					case 0x01:		// Flip X
-						writeTileToLayerBufferFlipX(tileBankNum, tileId, xPos, xOffset, yPos, yOffset, tileLayer0Ptr, tileLayerHeight, tileLayerWidth);
-						break;
-					case 0x02:		// Flip Y
-						writeTileToLayerBufferFlipY(tileBankNum, tileId, xPos, xOffset, yPos, yOffset, tileLayer0Ptr, tileLayerHeight, tileLayerWidth);
-						break;
-					case 0x03:		// Flip X and Y
-						writeTileToLayerBufferFlipXY(tileBankNum, tileId, xPos, xOffset, yPos, yOffset, tileLayer0Ptr, tileLayerHeight, tileLayerWidth);
-						break;
-					default:
-						debug_log("Invalid tileAttribute value: %d\r\n",tileFlip);
-				}
-			}
+		tileLayer.ringX = 0;
+		tileLayer.ringY = 0;
+		tileLayer.renderedXPos = sourceXPos;
+		tileLayer.renderedYPos = sourceYPos;
 
-			// If we're at the edge of the tile map, reset to the beginning.
-			sourceXPos++;
-			if (sourceXPos == tileMapWidth) { 
-				sourceXPos = 0; 
+		for (auto row=0; row<ringHeight; row++) {
+			for (auto column=0; column<ringWidth; column++) {
+				renderTileLayerCell(tileLayerNum, column, row);
 			}
 		}
 
-		// At the end of the row, reset sourceXPos back (else it will keep incrementing)
-		sourceXPos = tileLayer0.sourceXPos;
-	
-		sourceYPos++;
-		if (sourceYPos == tileMapHeight) {
-			sourceYPos = 0; 
-		}
+		tileLayer.dirtyTiles.clear();
+		tileLayer.ringValid = true;
+		tileLayer.outputValid = false;
 	}
-}
-
-
-void VDUStreamProcessor::vdu_sys_layers_tilelayer_draw_layerbuffer(uint8_t tileLayerNum) {
-
-	int xPix = 0;		// X position in pixels is now always 0 as the offset is written directly to the tileRowBuffer
-	int yPix = 0;
-
-	uint8_t tileLayerHeight;
-	uint8_t tileLayerWidth;
-
-	switch (tileLayerNum) {
-
-		case 0: {
-
-			if (tileLayer0init != 0) {
-				if (tileMap0 != NULL) {
 
-					tileLayerHeight = tileLayer0.height;
-					tileLayerWidth = tileLayer0.width;
+	// Re-render tiles that have been changed in the tile map
 
-				} else {
-					debug_log("vdu_sys_layers_tilelayer_renderlayer: tileMap0 is not initialised.\r\n");
-					return;
-				}
-			} else {
-				debug_log ("vdu_sys_layers_tilelayer_renderlayer: tileLayer0 is not initialised.\r\n");
-				return;
-			}
-		} break;
-
-		default: {
-			debug_log("vdu_sys_layers_tilelayer_renderlayer: Invalid tileLayerNum: %d\r\n",tileLayerNum);
-			return;
+	if (!tileLayer.dirtyTiles.empty()) {
+		for (auto cell : tileLayer.dirtyTiles) {
+			renderTileLayerCell(tileLayerNum, cell % ringWidth, cell / ringWidth);
 		}
+		tileLayer.dirtyTiles.clear();
+		tileLayer.outputValid = false;
 	}
 
-	int layerBufferWidth = tileLayerWidth * 8;
-	int layerBufferHeight = tileLayerHeight * 8;
-
-	// Do not continue if tileBank is not initialised.
-	if (tileBank0Data == NULL) { 
-		debug_log("vdu_sys_layers_tilelayer_renderlayer: tileBank0Data is not initialised.\r\n");
-		return;
+	if (xOffset != tileLayer.renderedXOffset || yOffset != tileLayer.renderedYOffset) {
+		tileLayer.outputValid = false;
 	}
 
-	tileLayer0Bitmap = Bitmap(layerBufferWidth, layerBufferHeight, tileLayer0Ptr, PixelFormat::RGBA2222);
-
-	canvas->drawBitmap(xPix,yPix,&tileLayer0Bitmap);		
-
-	// waitPlotCompletion();			// If enabled, then the code waits for VSYNC before continuing and is slower.
-
-}
-
-
-void VDUStreamProcessor::vdu_sys_layers_tilelayer_draw(uint8_t tileLayerNum) {
-
-	// auto startTime = xTaskGetTickCountFromISR();
-  	// auto endTime = xTaskGetTickCountFromISR();
-	// unsigned int elapsedTime;
-
-	// startTime = xTaskGetTickCountFromISR();
-
-	vdu_sys_layers_tilelayer_update_layerbuffer(tileLayerNum);
-
-	// endTime = xTaskGetTickCountFromISR();
-	// elapsedTime = endTime - startTime;
-	// debug_log("In vdu_sys_layers_tilelayer_draw: Tick rate: %dHz\r\n", configTICK_RATE_HZ);
-	// debug_log("In vdu_sys_layers_tilelayer_draw: vdu_sys_layers_tilelayer_update_layerbuffer() execution time: %d\r\n",elapsedTime);
-
-	// startTime = xTaskGetTickCountFromISR();
-
-	vdu_sys_layers_tilelayer_draw_layerbuffer(tileLayerNum);
+	if (tileLayer.outputValid) return;
 
-	// endTime = xTaskGetTickCountFromISR();
-	// elapsedTime = endTime - startTime;
-	// debug_log("In vdu_sys_layers_tilelayer_draw: vdu_sys_layers_tilelayer_draw_layerbuffer() execution time: %d\r\n",elapsedTime);
+	// Copy the visible area from the ring into the layer buffer, applying the sub-tile offsets
+	// Each line is at most two copies, as the visible area can wrap around the right edge of the ring
 
+	int ringPixelWidth = ringWidth * 8;
+	int ringPixelHeight = ringHeight * 8;
+	int layerBufferWidth = tileLayer.width * 8;
+	int layerBufferHeight = tileLayer.height * 8;
 
-}
+	int ringStartX = (tileLayer.ringX * 8) + xOffset;
+	int firstSpan = std::min(layerBufferWidth, ringPixelWidth - ringStartX);
 
-void VDUStreamProcessor::vdu_sys_layers_tilelayer_free(uint8_t tileLayerNum) {
+	for (auto y=0; y<layerBufferHeight; y++) {
+		int ringLine = ((tileLayer.ringY * 8) + yOffset + y) % ringPixelHeight;
+		uint8_t * source = tileLayer.ringPtr + (ringLine * ringPixelWidth);
+		uint8_t * dest = tileLayer.bufferPtr + (y * layerBufferWidth);
 
-	debug_log("In vdu_sys_layers_tilelayer_free: Before memory free call\n\r");
-	debug_log_mem();
-
-	switch (tileLayerNum) {
-		case 0: {
-			if (tileLayer0Buffer != NULL) {
-				debug_log("vdu_sys_layers_tilelayer_free: Freeing tileLayer0Buffer.\r\n");
-				heap_caps_free(tileLayer0Buffer);
-				tileLayer0Buffer = NULL;
-			}
-		} break;
-		
-		default: {
-			debug_log("vdu_sys_layers_tilelayer_free: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		memcpy(dest, source + ringStartX, firstSpan);
+		if (firstSpan < layerBufferWidth) {
+			memcpy(dest + firstSpan, source, layerBufferWidth - firstSpan);
 		}
 	}
 
-	debug_log("In vdu_sys_layers_tilelayer_free: After memory free call\r\n");
-	debug_log_mem();
+	tileLayer.renderedXOffset = xOffset;
+	tileLayer.renderedYOffset = yOffset;
+	tileLayer.outputValid = true;
+	tileCompositeValid = false;
 }
 
-// Tile drawing functions
+void VDUStreamProcessor::renderTileLayerCell(uint8_t tileLayerNum, int column, int row) {
 
-void VDUStreamProcessor::writeTileToLayerBuffer(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth) {
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-/*
-		The drawing loop reads from the source in a direction depending on the flip parameters:
-		- For normal drawing, read from top row to bottom row, left to right.
-		- For flip X drawing, read from top row to bottom row, right to left.
-		- For flip Y drawing, read from bottom row to top row, left to right.
-		- For flip X+Y drawing, read from bottom row to top row, right to left.
-		
-		Writes to the layer buffer are in a linear fashion: top row to bottom row, left to right.
+	int ringWidth = tileLayer.width + 1;
+	int ringHeight = tileLayer.height + 1;
+	uint8_t tileMapWidth = tileLayer.tileMapProperties.width;
+	uint8_t tileMapHeight = tileLayer.tileMapProperties.height;
 
-		The drawing loops for rows and columns (as defined by variables x and y) are intended to be
-		the counters for reading the *source* data. While there may be some cases where this can also
-		apply to the destination data, a separate set of variables are used to ensure clarity.
-	*/
+	// Find the tile map position shown in this ring cell, relative to the ring origin
 
-	int sourceTile = (tileId * 64);																	// The starting position in the tile bank for a given tileId;
-	int sourcePixel = 0;
-	int tileLayerPixelWidth = tileLayerWidth * 8;													// The width of the tile layer in pixels
-	int destLineStart = (yPos * tileLayerPixelWidth * 8 ) - (tileLayerPixelWidth * yOffset);		// The line where drawing the tile should be drawn
-	int destLineStartXOffset = (xPos * 8) - xOffset;												// The number of pixels along the line where the tile should be drawn
-	int destLineStartYOffset = 0;																	// The line in the tile (0-7) where the tile should be drawn
-	int destPixel;
-	int destPixelCount;
-	int destPixelStart;
-
-	// Point tileBankPtr to the specified tileBank
+	int mapX = (tileLayer.renderedXPos + ((column - tileLayer.ringX + ringWidth) % ringWidth)) % tileMapWidth;
+	int mapY = (tileLayer.renderedYPos + ((row - tileLayer.ringY + ringHeight) % ringHeight)) % tileMapHeight;
 
-	uint8_t * tileBankPtr;				
-
-	switch (tileBankNum) {
-		case 0: {				// Tile Bank 0
-			tileBankPtr = tileBank0Ptr;
-		} break;
+	uint16_t tile = tileLayer.tileMap[(mapY * tileMapWidth) + mapX];
+	uint8_t tileId = tile & 0xFF;
+	uint8_t tileAttribute = tile >> 8;
 
-		case 1: {				// Tile Bank 1
-			tileBankPtr = tileBank1Ptr;
-		} break;
+	int ringPixelWidth = ringWidth * 8;
+	uint8_t * dest = tileLayer.ringPtr + (row * 8 * ringPixelWidth) + (column * 8);
 
-		case 2: {				// Tile Bank 2
-			tileBankPtr = tileBank2Ptr;
-		} break;
+	// Tile 0 is special, and is not drawn. Tiles from banks that are not initialised are also not drawn.
+	// Both show the layer background colour (default 0 = transparent).
+	// Check attribute to get the tile bank number (from bits 2 and 3)
 
-		case 3: {				// Tile Bank 3
-			tileBankPtr = tileBank3Ptr;
-		} break;
+	uint8_t * tileBankPtr = tileId == 0 ? NULL : getTileBankPtr((tileAttribute & 0x0C) >> 2);
 
-		default: {
-			debug_log("writeTileToLayerBuffer: Invalid tilebank %d specified.\r\n",tileBankNum);
-			return;
+	if (tileBankPtr == NULL) {
+		for (auto y=0; y<8; y++) {
+			memset(dest + (y * ringPixelWidth), tileLayer.backgroundColour, 8);
 		}
+		return;
 	}
 
-	/* 
-	Set the start and end variables used in the source reading loop depending on whether it is the first, middle or last column:
-	- For the first column (0), then potentially only read the last "n" pixels in the tile row.
-	- For columns in the middle (1 through to tileLayerWidth -1), then read all eight pixels in the tile row.
-	- For the last column (tileLayerWidth), then potentially only read the first "n" pixels. 
-	*/
-
-	if (yPos > 0 && yPos < tileLayerHeight) {
-
-		if (xPos > 0 && xPos < tileLayerWidth) {		// Process the most common use-case (middle tiles) first
-
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}  			
-		} else if (xPos == 0) {							// Process the first column
-
-			destLineStartXOffset = 0;
-
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	// Check attribute to get tile draw direction (from bits 0 and 1)
 
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			} 
-		} else if (xPos == tileLayerWidth) {			// Process the last column
-		
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		}
-
-	} else if (yPos == 0) {
-
-		// Do the top row
-
-		if (xPos > 0 && xPos < tileLayerWidth) {		// Process the most common use-case (middle tiles) first
-
-			for (auto y=yOffset; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-
-		} else if (xPos == 0) {							// Process the first column
-
-	 		destLineStartXOffset = 0;
-
- 			for (auto y=yOffset; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		} else if (xPos == tileLayerWidth) {			// Process the last column
-		
- 			for (auto y=yOffset; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			} 
-		}
-
-
-	} else if (yPos == tileLayerHeight) {
-
-		// Do the bottom row
-
-		if (xPos > 0 && xPos < tileLayerWidth) {		// Process the most common use-case (middle tiles) first
-
-		 	for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-
-			// debug_log("Bottom Row Middle: destPixel address: %d\r\n", &tileBuffer[destPixel]);
-
-		} else if (xPos == 0) {							// Process the first column
-
-			destLineStartXOffset = 0;
-
-			for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-
-			// debug_log("Bottom Row Column 0: destPixel address: %d\r\n", &tileBuffer[destPixel]);
-
-		} else if (xPos == tileLayerWidth) {			// Process the last column
-	
-			for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-
-			// The output will be random if y and x never match and the loops never execute.
-			// debug_log("Bottom Row End: destPixel address: %d\r\n", &tileBuffer[destPixel]);
-		} 
-	}
+	writeTileToLayerRing(tileBankPtr, tileId, tileAttribute & 0x03, tileLayer.backgroundColour, dest, ringPixelWidth);
 }
 
-void VDUStreamProcessor::writeTileToLayerBufferFlipX(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth) {
-
-	int sourceTile = (tileId * 64);
-	int sourcePixel = 0;
-	int tileLayerPixelWidth = tileLayerWidth * 8;
-	int destLineStart = (yPos * tileLayerPixelWidth * 8 ) - (tileLayerPixelWidth * yOffset);
-	int destLineStartXOffset = (xPos * 8) - xOffset;
-	int destLineStartYOffset = 0;	
-	int destPixel;
-	int destPixelCount;
-	int destPixelStart;
-
-		// Point tileBankPtr to the specified tileBank
-
-		uint8_t * tileBankPtr;				
-
-		switch (tileBankNum) {
-			case 0: {				// Tile Bank 0
-				tileBankPtr = tileBank0Ptr;
-			} break;
-	
-			case 1: {				// Tile Bank 1
-				tileBankPtr = tileBank1Ptr;
-			} break;
-	
-			case 2: {				// Tile Bank 2
-				tileBankPtr = tileBank2Ptr;
-			} break;
-	
-			case 3: {				// Tile Bank 3
-				tileBankPtr = tileBank3Ptr;
-			} break;
-	
-			default: {
-				debug_log("writeTileToLayerBufferFlipX: Invalid tilebank %d specified.\r\n",tileBankNum);
-				return;
-			}
-		}
-
-	if (yPos > 0 && yPos < tileLayerHeight) {
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}  
-		} else if (xPos == 0) {
-
-			destLineStartXOffset = 0;
-
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			} 
-		} else if (xPos == tileLayerWidth) {
-
-			for (auto y=0; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		}
-	
-	}  else if (yPos == 0) {
-
-		// Do the top row
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=yOffset; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-			
-		} else if (xPos == 0) {
-
- 			destLineStartXOffset = 0;
-
-			for (auto y=xOffset; y<8; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-
-		} else if (xPos == tileLayerWidth) {
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_invalidate() {
 
- 			for (auto y=xOffset; y<8; y++) {
+	// Tile bank contents have changed, so every layer must be re-rendered in full
 
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		}
-
-	} else if (yPos == tileLayerHeight) {
-
-		// Do the bottom row
-		
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}  
-		} else if (xPos == 0) {
-
-			destLineStartXOffset = 0;
-
-			for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		} else if (xPos == tileLayerWidth) {
-
-			for (auto y=0; y<=yOffset; y++) {
-
-				destLineStartYOffset = tileLayerPixelWidth * y;
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-			}
-		} 
-	}	
+	for (auto i=0; i<TILE_LAYERS; i++) {
+		tileLayers[i].ringValid = false;
+	}
 }
 
-void VDUStreamProcessor::writeTileToLayerBufferFlipY(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth) {
- 
-	int sourceTile = (tileId * 64);
-	int sourcePixel = 0;
-	int tileLayerPixelWidth = tileLayerWidth * 8;
-	int destLineStart = (yPos * tileLayerPixelWidth * 8 ) - (tileLayerPixelWidth * yOffset);
-	int destLineStartXOffset = (xPos * 8) - xOffset;
-	int destLineStartYOffset = 0;								// Start writing from the top line
-	int destPixel;
-	int destPixelCount;
-	int destPixelStart;
-
-	// Point tileBankPtr to the specified tileBank
-
-	uint8_t * tileBankPtr;				
+uint8_t * VDUStreamProcessor::getTileBankPtr(uint8_t tileBankNum) {
 
 	switch (tileBankNum) {
-		case 0: {				// Tile Bank 0
-			tileBankPtr = tileBank0Ptr;
-		} break;
-
-		case 1: {				// Tile Bank 1
-			tileBankPtr = tileBank1Ptr;
-		} break;
-
-		case 2: {				// Tile Bank 2
-			tileBankPtr = tileBank2Ptr;
-		} break;
-
-		case 3: {				// Tile Bank 3
-			tileBankPtr = tileBank3Ptr;
-		} break;
-
-		default: {
-			debug_log("writeTileLayerToBufferFlipY: Invalid tilebank %d specified.\r\n",tileBankNum);
-			return;
-		}
+		case 0: return tileBank0Data != NULL ? tileBank0Ptr : NULL;
+		case 1: return tileBank1Data != NULL ? tileBank1Ptr : NULL;
+		case 2: return tileBank2Data != NULL ? tileBank2Ptr : NULL;
+		case 3: return tileBank3Data != NULL ? tileBank3Ptr : NULL;
 	}
-	
-	if (yPos > 0 && yPos < tileLayerHeight) {
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=7; y>=0; y--) {
+	return NULL;
+}
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
 
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_draw_layerbuffer(uint8_t tileLayerNum) {
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}	
+	int xPix = 0;		// X position in pixels is now always 0 as the offset is written directly to the tileRowBuffer
+	int yPix = 0;
 
-		} else if (xPos == 0) {
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_renderlayer: Invalid tileLayerNum: %d\r\n",tileLayerNum);
+		return;
+	}
 
-			destLineStartXOffset = 0;							// Need to override destStartLineXOffset to start at column 0 with no xOffset
-					
-			for (auto y=7; y>=0; y--) {
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;														// Need to track destination pixel counter as x starts with an offset
+	if (tileLayer.init == 0) {
+		debug_log ("vdu_sys_layers_tilelayer_renderlayer: tileLayer %d is not initialised.\r\n", tileLayerNum);
+		return;
+	}
+	if (tileLayer.tileMap == NULL) {
+		debug_log("vdu_sys_layers_tilelayer_renderlayer: tileMap %d is not initialised.\r\n", tileLayerNum);
+		return;
+	}
 
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+	int layerBufferWidth = tileLayer.width * 8;
+	int layerBufferHeight = tileLayer.height * 8;
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;		// Update destLineStartYOffset to the next line.
-			}
+	// Do not continue if tileBank is not initialised.
+	if (tileBank0Data == NULL) { 
+		debug_log("vdu_sys_layers_tilelayer_renderlayer: tileBank0Data is not initialised.\r\n");
+		return;
+	}
 
-		} else if (xPos == tileLayerWidth) {
+	tileLayer.bitmap = Bitmap(layerBufferWidth, layerBufferHeight, tileLayer.bufferPtr, PixelFormat::RGBA2222);
 
-			for (auto y=7; y>=0; y--) {
+	canvas->drawBitmap(xPix,yPix,&tileLayer.bitmap);		
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;	
+	// waitPlotCompletion();			// If enabled, then the code waits for VSYNC before continuing and is slower.
 
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + destPixelCount;
-					destPixel = destPixelStart + x;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+}
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}
-		}	
 
-	} else if (yPos == 0) {
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_draw(uint8_t tileLayerNum) {
 
-	 	// Do the top row
+	// auto startTime = xTaskGetTickCountFromISR();
+  	// auto endTime = xTaskGetTickCountFromISR();
+	// unsigned int elapsedTime;
 
-		destLineStart = 0;		// We are only reading a smaller number of lines, so start from 0, not a negative start y position.
+	// startTime = xTaskGetTickCountFromISR();
 
-		if (xPos > 0 && xPos < tileLayerWidth) {
+	if (tileLayerNum == TILE_LAYER_ALL) {
+		vdu_sys_layers_tilelayer_composite();
+		return;
+	}
 
-			for (auto y=(7-yOffset); y>=0; y--) {
+	vdu_sys_layers_tilelayer_update_layerbuffer(tileLayerNum);
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	// endTime = xTaskGetTickCountFromISR();
+	// elapsedTime = endTime - startTime;
+	// debug_log("In vdu_sys_layers_tilelayer_draw: Tick rate: %dHz\r\n", configTICK_RATE_HZ);
+	// debug_log("In vdu_sys_layers_tilelayer_draw: vdu_sys_layers_tilelayer_update_layerbuffer() execution time: %d\r\n",elapsedTime);
 
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+	// startTime = xTaskGetTickCountFromISR();
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}	 
+	vdu_sys_layers_tilelayer_draw_layerbuffer(tileLayerNum);
 
-		} else if (xPos == 0) {
+	// endTime = xTaskGetTickCountFromISR();
+	// elapsedTime = endTime - startTime;
+	// debug_log("In vdu_sys_layers_tilelayer_draw: vdu_sys_layers_tilelayer_draw_layerbuffer() execution time: %d\r\n",elapsedTime);
 
- 			destLineStartXOffset = 0;							// Need to override destStartLineXOffset to start at column 0 with no xOffset
-					
-			for (auto y=(7-yOffset); y>=0; y--) {
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;														// Need to track destination pixel counter as x starts with an offset
+}
 
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_composite() {
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;		// Update destLineStartYOffset to the next line.
-			}
+	/*
+		Composite every layer that has a tile map into one buffer, and draw it with a single drawBitmap.
 
-		} else if (xPos == tileLayerWidth) {
+		Layers are stacked in priority order, lowest first, with ties drawn in layer number order.
+		Each row of the composite buffer is built once: the row is cleared, then each layer's row is
+		laid over it, skipping pixels that are transparent (alpha 0) or match the layer's transparent colour.
+		The rebuild is skipped when no layer buffer has been copied again and no layer has changed since the last one.
+	*/
 
- 			for (auto y=(7-yOffset); y>=0; y--) {
+	uint8_t layerOrder[TILE_LAYERS];
+	uint8_t layerCount = 0;
+	int compositeWidth = 0;
+	int compositeHeight = 0;
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;	
+	for (auto i=0; i<TILE_LAYERS; i++) {
+		if (tileLayers[i].init == 0 || tileLayers[i].tileMap == NULL) continue;
 
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + destPixelCount;
-					destPixel = destPixelStart + x;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+		vdu_sys_layers_tilelayer_update_layerbuffer(i);
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}  
+		// Insert the layer into the draw order
+		auto n = layerCount++;
+		while (n > 0 && tileLayers[layerOrder[n - 1]].priority > tileLayers[i].priority) {
+			layerOrder[n] = layerOrder[n - 1];
+			n--;
 		}
-				
-	} else if (yPos == tileLayerHeight) {
-
-		// Do the bottom row
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=0; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}	
+		layerOrder[n] = i;
 
-		} else if (xPos == 0) {
-
-			destLineStartXOffset = 0;							// Need to override destStartLineXOffset to start at column 0 with no xOffset
-					
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;														// Need to track destination pixel counter as x starts with an offset
-
-				for (auto x=xOffset; x<8; x++) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;		// Update destLineStartYOffset to the next line.
-			}
-
-		} else if (xPos == tileLayerWidth) {
-
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;	
-
-				for (auto x=0; x<xOffset; x++) {
-					sourcePixel = sourceTile + (y * 8) + destPixelCount;
-					destPixel = destPixelStart + x;
-					tileBuffer[destPixel]=tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}
-		} 	
+		compositeWidth = std::max(compositeWidth, tileLayers[i].width * 8);
+		compositeHeight = std::max(compositeHeight, tileLayers[i].height * 8);
 	}
-}
-
-void VDUStreamProcessor::writeTileToLayerBufferFlipXY(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth) {
- 
-	int sourceTile = (tileId * 64);	
-	int sourcePixel = 0;
-	int tileLayerPixelWidth = tileLayerWidth * 8;
-	int destLineStart = (yPos * tileLayerPixelWidth * 8 ) - (tileLayerPixelWidth * yOffset);
-	int destLineStartXOffset = (xPos * 8) - xOffset;
-	int destLineStartYOffset = 0;
-	int destPixel;
-	int destPixelCount = 0;
-	int destPixelStart;
-
-	// Point tileBankPtr to the specified tileBank
-
-	uint8_t * tileBankPtr;				
-
-	switch (tileBankNum) {
-		case 0: {				// Tile Bank 0
-			tileBankPtr = tileBank0Ptr;
-		} break;
 
-		case 1: {				// Tile Bank 1
-			tileBankPtr = tileBank1Ptr;
-		} break;
+	if (layerCount == 0) {
+		debug_log("vdu_sys_layers_tilelayer_composite: No tile layers are ready to draw.\r\n");
+		return;
+	}
 
-		case 2: {				// Tile Bank 2
-			tileBankPtr = tileBank2Ptr;
-		} break;
+	// Do not continue if tileBank is not initialised.
+	if (tileBank0Data == NULL) { 
+		debug_log("vdu_sys_layers_tilelayer_composite: tileBank0Data is not initialised.\r\n");
+		return;
+	}
 
-		case 3: {				// Tile Bank 3
-			tileBankPtr = tileBank3Ptr;
-		} break;
+	int compositeBufferSize = compositeWidth * compositeHeight;
 
-		default: {
-			debug_log("writeTileToLayerBufferFlipXY: Invalid tilebank %d specified.\r\n",tileBankNum);
+	if (tileCompositeBufferSize != compositeBufferSize) {
+		if (tileCompositeBuffer != NULL) {
+			waitPlotCompletion();
+			heap_caps_free(tileCompositeBuffer);
+		}
+		tileCompositeBuffer = heap_caps_malloc(compositeBufferSize,MALLOC_CAP_SPIRAM);
+		if (tileCompositeBuffer == NULL) {
+			debug_log("vdu_sys_layers_tilelayer_composite: Failed to allocate composite buffer.\r\n");
+			tileCompositeBufferSize = 0;
 			return;
 		}
+		tileCompositeBufferSize = compositeBufferSize;
+		tileCompositeValid = false;
 	}
 
-	if (yPos > 0 && yPos < tileLayerHeight) {
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=7; y>=0; y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	uint8_t * compositePtr = (uint8_t *)tileCompositeBuffer;
 
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}  
-
-		} else if (xPos == 0) {
-
-			destLineStartXOffset = 0;
-
-			for (auto y=7; y>=0; y--) {
+	if (tileCompositeValid) {
+		canvas->drawBitmap(0,0,&tileCompositeBitmap);
+		return;
+	}
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	for (auto y=0; y<compositeHeight; y++) {
 
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+		uint8_t * dest = compositePtr + (y * compositeWidth);
+		memset(dest, 0, compositeWidth);
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			} 
+		for (auto i=0; i<layerCount; i++) {
 
-		} else if (xPos == tileLayerWidth) {
+			TileLayer &tileLayer = tileLayers[layerOrder[i]];
+			int layerWidth = tileLayer.width * 8;
 
-			for (auto y=7; y>=0; y--) {
+			if (y >= tileLayer.height * 8) continue;
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+			uint8_t * source = tileLayer.bufferPtr + (y * layerWidth);
+			uint8_t transparentColour = tileLayer.transparentColour;
 
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
+			for (auto x=0; x<layerWidth; x++) {
+				uint8_t pixel = source[x];
+				if ((pixel & 0xC0) != 0 && pixel != transparentColour) {
+					dest[x] = pixel;
 				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
 			}
 		}
+	}
 
-	} else if (yPos == 0) {
-
-		// Do the top row
-
-		destLineStart = 0;
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
- 			for (auto y=(7-yOffset); y>=0; y--) {
+	tileCompositeBitmap = Bitmap(compositeWidth, compositeHeight, compositePtr, PixelFormat::RGBA2222);
+	tileCompositeValid = true;
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	canvas->drawBitmap(0,0,&tileCompositeBitmap);
+}
 
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+void VDUStreamProcessor::vdu_sys_layers_tilelayer_free(uint8_t tileLayerNum) {
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			} 
+	debug_log("In vdu_sys_layers_tilelayer_free: Before memory free call\n\r");
+	debug_log_mem();
 
-		} else if (xPos == 0) {
+	if (tileLayerNum >= TILE_LAYERS) {
+		debug_log("vdu_sys_layers_tilelayer_free: Invalid tileLayerNum %d specified.\r\n",tileLayerNum);
+		return;
+	}
 
-		 	destLineStartXOffset = 0;
+	TileLayer &tileLayer = tileLayers[tileLayerNum];
 
-			for (auto y=(7-yOffset); y>=0; y--) {
+	if (tileLayer.buffer != NULL) {
+		debug_log("vdu_sys_layers_tilelayer_free: Freeing tile layer %d buffer.\r\n", tileLayerNum);
+		waitPlotCompletion();
+		heap_caps_free(tileLayer.buffer);
+		tileLayer.buffer = NULL;
+	}
+	if (tileLayer.ringBuffer != NULL) {
+		heap_caps_free(tileLayer.ringBuffer);
+		tileLayer.ringBuffer = NULL;
+	}
+	tileLayer.dirtyTiles.clear();
+	tileLayer.ringValid = false;
+	tileLayer.init = 0;
+	tileCompositeValid = false;
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	debug_log("In vdu_sys_layers_tilelayer_free: After memory free call\r\n");
+	debug_log_mem();
+}
 
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+// Tile drawing functions
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}
+void VDUStreamProcessor::writeTileToLayerRing(uint8_t * tileBankPtr, uint8_t tileId, uint8_t tileFlip, uint8_t backgroundColour, uint8_t * dest, int destStride) {
 
-		} else if (xPos == tileLayerWidth) {
+	/*
+		Writes a whole tile into the layer ring, one tile row per destination line.
+		- For flip X drawing, each row is read from right to left.
+		- For flip Y drawing, the rows are read from bottom to top.
+		- Fully transparent tile pixels are replaced by a visible background colour.
+	*/
 
-			for (auto y=(7-yOffset); y>=0; y--) {
+	uint8_t * sourceTile = tileBankPtr + (tileId * 64);
+	bool fillBackground = (backgroundColour & 0xC0) != 0;
 
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
+	for (auto y=0; y<8; y++) {
 
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
+		uint8_t * sourceRow = sourceTile + (((tileFlip & 0x02) ? 7 - y : y) * 8);
+		uint8_t * destRow = dest + (y * destStride);
 
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
+		if (tileFlip & 0x01) {
+			for (auto x=0; x<8; x++) {
+				destRow[x] = sourceRow[7 - x];
 			}
+		} else {
+			memcpy(destRow, sourceRow, 8);
 		}
 
-	} else if (yPos == tileLayerHeight) {
-
-		// Do the bottom row
-
-		if (xPos > 0 && xPos < tileLayerWidth) {
-
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			}  
-
-		} else if (xPos == 0) {
-
-			destLineStartXOffset = 0;
-
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=(7-xOffset); x>=0; x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			} 
-
-		} else if (xPos == tileLayerWidth) {
-
-			for (auto y=7; y>=(7-yOffset); y--) {
-
-				destPixelStart = destLineStart + destLineStartYOffset + destLineStartXOffset;
-				destPixelCount = 0;
-
-				for (auto x=7; x>(7-xOffset); x--) {
-					sourcePixel = sourceTile + (y * 8) + x;
-					destPixel = destPixelStart + destPixelCount;
-					tileBuffer[destPixel] = tileBankPtr[sourcePixel];
-					destPixelCount++;
-				}
-
-				destLineStartYOffset = destLineStartYOffset + tileLayerPixelWidth;
-			} 
+		if (fillBackground) {
+			for (auto x=0; x<8; x++) {
+				if ((destRow[x] & 0xC0) == 0) destRow[x] = backgroundColour;
+			}
 		}
-
 	}
 }
 
-
-
 void VDUStreamProcessor::writeTileToBuffer(uint8_t tileBankNum, uint8_t tileId, uint8_t tileCount, uint8_t xOffset, uint8_t tileBuffer[], uint8_t tileLayerWidth) {
 
 	int destStartPos;
@@ -6,6 +6,7 @@
 
 #include "agon_ps2.h"
 #include "buffers.h"
+#include "sprite_collisions.h"
 #include "sprites.h"
 #include "types.h"
 #include "vdu_stream_processor.h"
@@ -19,6 +20,9 @@ void VDUStreamProcessor::vdu_sys_sprites() {
 		case 0: {	// Select bitmap
 			auto rb = readByte_t();
 			if (rb >= 0) {
+				if (recordingList && recordListEntry(DISPLAY_LIST_BITMAP_SELECT, 0, 0, rb + BUFFERED_BITMAP_BASEID, 0)) {
+					return;
+				}
 				context->setCurrentBitmap(rb + BUFFERED_BITMAP_BASEID);
 				debug_log("vdu_sys_sprites: bitmap %d selected\n\r", context->getCurrentBitmapId());
 			}
@@ -61,6 +65,9 @@ void VDUStreamProcessor::vdu_sys_sprites() {
 			auto rx = readWord_t(); if (rx == -1) return;
 			auto ry = readWord_t(); if (ry == -1) return;
 
+			if (recordingList && recordListEntry(DISPLAY_LIST_BITMAP_DRAW, 0, 0, rx, ry)) {
+				return;
+			}
 			context->drawBitmap(rx,ry, false, true);
 			debug_log("vdu_sys_sprites: bitmap %d draw command\n\r", context->getCurrentBitmapId());
 		}	break;
@@ -148,6 +155,7 @@ void VDUStreamProcessor::vdu_sys_sprites() {
 		case 16: {	// Reset
 			resetMouseCursors();
 			resetSprites();
+			resetSpriteCollisions();
 			resetBitmaps();
 			// TODO reset current bitmaps in all processors
 			context->setCurrentBitmap(BUFFERED_BITMAP_BASEID);
@@ -158,6 +166,7 @@ void VDUStreamProcessor::vdu_sys_sprites() {
 
 		case 17: {	// Reset sprites only
 			resetSprites();
+			resetSpriteCollisions();
 			debug_log("vdu_sys_sprites: reset sprites\n\r");
 		}	break;
 
@@ -185,9 +194,52 @@ void VDUStreamProcessor::vdu_sys_sprites() {
 			debug_log("vdu_sys_sprites: sprite %d - replace frame %d\n\r", getCurrentSprite(), b);
 		}	break;
 
+		case 22: {	// Update sprites from buffer
+			auto bufferId = readWord_t(); if (bufferId == -1) return;
+			auto count = readWord_t(); if (count == -1) return;
+			updateSpritesFromBuffer(bufferId, count);
+			debug_log("vdu_sys_sprites: sprites updated from buffer %d\n\r", bufferId);
+		}	break;
+
+		case 23: {	// Set collision groups for sprite
+			auto groups = readByte_t(); if (groups == -1) return;
+			setSpriteCollisionGroups(groups);
+			debug_log("vdu_sys_sprites: sprite %d - collision groups set to 0x%02X\n\r", getCurrentSprite(), groups);
+		}	break;
+
+		case 24: {	// Test sprite for collisions with all others
+			auto b = readByte_t(); if (b == -1) return;
+			auto hits = testSpriteCollisions(b);
+			setVDPVariable(VDPVAR_SPRITE_HITS, hits);
+			setVDPVariable(VDPVAR_SPRITE_HIT_A, hits ? collisionResults[0] : 65535);
+			setVDPVariable(VDPVAR_SPRITE_HIT_B, 65535);
+			debug_log("vdu_sys_sprites: sprite %d - %d collisions\n\r", b, hits);
+		}	break;
+
+		case 25: {	// Test collision groups A against B
+			auto groupsA = readByte_t(); if (groupsA == -1) return;
+			auto groupsB = readByte_t(); if (groupsB == -1) return;
+			auto hits = testSpriteGroupCollisions(groupsA, groupsB);
+			setVDPVariable(VDPVAR_SPRITE_HITS, hits);
+			setVDPVariable(VDPVAR_SPRITE_HIT_A, hits ? collisionResults[0] : 65535);
+			setVDPVariable(VDPVAR_SPRITE_HIT_B, hits ? collisionResults[1] : 65535);
+			debug_log("vdu_sys_sprites: groups 0x%02X against 0x%02X - %d collisions\n\r", groupsA, groupsB, hits);
+		}	break;
+
+		case 26: {	// Write collisions of groups A against B to a buffer
+			auto bufferId = readWord_t(); if (bufferId == -1) return;
+			auto groupsA = readByte_t(); if (groupsA == -1) return;
+			auto groupsB = readByte_t(); if (groupsB == -1) return;
+			spriteCollisionsToBuffer(bufferId, groupsA, groupsB);
+			debug_log("vdu_sys_sprites: collisions written to buffer %d\n\r", bufferId);
+		}	break;
+
 		// Extended bitmap commands
 		case 0x20: {	// Select bitmap, 16-bit buffer ID
 			auto b = readWord_t(); if (b == -1) return;
+			if (recordingList && recordListEntry(DISPLAY_LIST_BITMAP_SELECT, 0, 0, b, 0)) {
+				return;
+			}
 			context->setCurrentBitmap((uint16_t) b);
 			debug_log("vdu_sys_sprites: bitmap %d selected\n\r", context->getCurrentBitmapId());
 		}	break;
@@ -344,7 +396,77 @@ void VDUStreamProcessor::createBitmapFromBuffer(uint16_t bufferId, uint8_t forma
 	} else {
 		bitmaps[bufferId] = make_shared_psram<Bitmap>(width, height, (uint8_t *)data, pixelFormat);
 	}
+	bitmapGeneration++;
 	debug_log("vdu_sys_sprites: bitmap created for bufferId %d, format %d, (%dx%d)\n\r", bufferId, format, width, height);
 }
 
+// Apply a batch of sprite updates from a buffer, then refresh sprites once
+// Each record is sprite ID, flags, X; Y; and frame, with the flags choosing which parts of a record apply
+// A count of 0 applies every record in the buffer
+//
+void VDUStreamProcessor::updateSpritesFromBuffer(uint16_t bufferId, uint16_t count) {
+	auto bufferIter = buffers.find(bufferId);
+	if (bufferIter == buffers.end()) {
+		debug_log("updateSpritesFromBuffer: buffer %d not found\n\r", bufferId);
+		return;
+	}
+	auto &buffer = bufferIter->second;
+
+	AdvancedOffset offset = {};
+	uint32_t remaining = count == 0 ? 0xFFFFFFFF : count;
+	while (remaining) {
+		auto span = getBufferSpan(buffer, offset, SPRITE_UPDATE_RECORD_SIZE);
+		if (span.empty()) {
+			break;
+		}
+		// apply all the whole records in this block
+		auto records = std::min<uint32_t>(remaining, span.size() / SPRITE_UPDATE_RECORD_SIZE);
+		auto record = span.data();
+		for (uint32_t i = 0; i < records; i++, record += SPRITE_UPDATE_RECORD_SIZE) {
+			auto sprite = getSprite(record[0]);
+			auto flags = record[1];
+			int16_t x = record[2] | (record[3] << 8);
+			int16_t y = record[4] | (record[5] << 8);
+			if (flags & SPRITE_UPDATE_MOVE) {
+				sprite->moveTo(x, y);
+			} else if (flags & SPRITE_UPDATE_MOVE_BY) {
+				sprite->moveBy(x, y);
+			}
+			if ((flags & SPRITE_UPDATE_FRAME) && record[6] < sprite->framesCount) {
+				sprite->setFrame(record[6]);
+			}
+			if (flags & SPRITE_UPDATE_SHOW) {
+				sprite->visible = 1;
+			}
+			if (flags & SPRITE_UPDATE_HIDE) {
+				sprite->visible = 0;
+			}
+		}
+		remaining -= records;
+		offset.blockOffset += records * SPRITE_UPDATE_RECORD_SIZE;
+	}
+	refreshSprites();
+}
+
+// Replace a buffer with the colliding pairs of sprites from groups A and B, as two bytes per pair, A side first
+// The pair count is also set in VDP variables, and when there are no collisions the buffer is just cleared
+//
+void VDUStreamProcessor::spriteCollisionsToBuffer(uint16_t bufferId, uint8_t groupsA, uint8_t groupsB) {
+	auto hits = testSpriteGroupCollisions(groupsA, groupsB);
+	setVDPVariable(VDPVAR_SPRITE_HITS, hits);
+	setVDPVariable(VDPVAR_SPRITE_HIT_A, hits ? collisionResults[0] : 65535);
+	setVDPVariable(VDPVAR_SPRITE_HIT_B, hits ? collisionResults[1] : 65535);
+
+	bufferClear(bufferId);
+	if (hits == 0) {
+		return;
+	}
+	auto buffer = bufferCreate(bufferId, collisionResults.size());
+	if (!buffer) {
+		debug_log("spriteCollisionsToBuffer: failed to create buffer %d\n\r", bufferId);
+		return;
+	}
+	memcpy(buffer->getBuffer(), collisionResults.data(), collisionResults.size());
+}
+
 #endif // _VDU_SPRITES_H_
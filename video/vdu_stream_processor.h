@@ -41,6 +41,10 @@ class VDUStreamProcessor {
 
 		std::vector<uint8_t> echoBuffer;
 
+		bool recordingList = false;				// Graphics commands are being recorded to a display list
+		uint16_t recordingListId = 65535;		// Buffer the display list will be stored in
+		std::vector<DisplayListEntry, psram_allocator<DisplayListEntry>> recordedList;
+
 		int16_t readByte_t(uint16_t timeout);
 		int32_t readWord_t(uint16_t timeout);
 		int32_t read24_t(uint16_t timeout);
@@ -81,6 +85,7 @@ class VDUStreamProcessor {
 		void sendScreenPixel(uint16_t x, uint16_t y);
 		void sendColour(uint8_t colour);
 		void sendScrPixelPacket();
+		void sendScreenRegion(uint8_t format, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t bufferId);
 		void printBuffer(uint16_t bufferId);
 		void sendTime();
 		void vdu_sys_video_time();
@@ -112,6 +117,7 @@ class VDUStreamProcessor {
 		void saveAndSelectContext(uint8_t contextId);
 		void restoreAllContexts();
 		void clearContextStack();
+		void unshareTopContext();
 		void resetAllContexts();
 
 		void vdu_sys_sprites();
@@ -119,6 +125,8 @@ class VDUStreamProcessor {
 		void createBitmapFromScreen(uint16_t bufferId);
 		void createEmptyBitmap(uint16_t bufferId, uint16_t width, uint16_t height, uint32_t color);
 		void createBitmapFromBuffer(uint16_t bufferId, uint8_t format, uint16_t width, uint16_t height);
+		void updateSpritesFromBuffer(uint16_t bufferId, uint16_t count);
+		void spriteCollisionsToBuffer(uint16_t bufferId, uint8_t groupsA, uint8_t groupsB);
 
 		void vdu_sys_hexload(void);
 		void sendKeycodeByte(uint8_t b, bool waitack);
@@ -127,6 +135,7 @@ class VDUStreamProcessor {
 		uint32_t bufferWrite(uint16_t bufferId, uint32_t size);
 		void bufferCall(uint16_t bufferId, AdvancedOffset offset);
 		void bufferRemoveUsers(uint16_t bufferId);
+		void bufferContentsChanged(uint16_t bufferId);
 		void bufferClear(uint16_t bufferId);
 		std::shared_ptr<WritableBufferStream> bufferCreate(uint16_t bufferId, uint32_t size);
 		void setOutputStream(uint16_t bufferId);
@@ -149,6 +158,13 @@ class VDUStreamProcessor {
 		void bufferMatrixManipulate(uint16_t bufferId, uint8_t command, MatrixSize size);
 		void bufferTransformBitmap(uint16_t bufferId, uint8_t options, uint16_t transformBufferId, uint16_t sourceBufferId);
 		void bufferTransformData(uint16_t bufferId, uint8_t options, uint8_t format, uint16_t transformBufferId, uint16_t sourceBufferId);
+		void bufferPlot(uint16_t bufferId, uint8_t options, uint8_t command, uint8_t format);
+		void bufferRecordList(uint16_t bufferId);
+		void bufferEndList();
+		void bufferReplayList(uint16_t bufferId, int16_t offsetX, int16_t offsetY);
+		void bufferPatchList(uint16_t bufferId, uint16_t index, uint8_t flags, int16_t x, int16_t y, uint8_t colour);
+		bool recordListEntry(uint8_t type, uint8_t command, uint8_t colour, int16_t x, int16_t y);
+		void resetListRecording();
 		void bufferReadVariable(uint16_t bufferId);
 		void bufferCompress(uint16_t bufferId, uint16_t sourceBufferId);
 		void bufferDecompress(uint16_t bufferId, uint16_t sourceBufferId);
@@ -166,26 +182,32 @@ class VDUStreamProcessor {
 		void vdu_sys_layers();
 		void vdu_sys_layers_tilebank_init(uint8_t tileBankNum, uint8_t tileBankBitDepth);
 		void vdu_sys_layers_tilebank_load(uint8_t tileBankNum, uint8_t tileId);
+		void vdu_sys_layers_tilebank_load_buffer(uint8_t tileBankNum, uint8_t tileId, uint16_t bufferId, uint8_t tileCount, uint8_t options);
 		void vdu_sys_layers_tilebank_draw(uint8_t tileBankNum, uint8_t tileId, uint8_t palette, uint8_t x, uint8_t y, uint8_t xOffset, uint8_t yOffset, uint8_t tileAttribute);
 		void vdu_sys_layers_tilebank_free(uint8_t tileBankNum);
 		void vdu_sys_layers_tilemap_init(uint8_t tileLayerNum, uint8_t tileMapSize);
 		void vdu_sys_layers_tilemap_set(uint8_t tileLayerNum, uint8_t x, uint8_t y, uint8_t tileId, uint8_t tileAttribute);
+		void vdu_sys_layers_tilemap_set_multiple(uint8_t tileLayerNum, uint8_t x, uint8_t y, uint8_t width, uint8_t height);
+		void vdu_sys_layers_tilemap_load_buffer(uint8_t tileLayerNum, uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint16_t bufferId);
+		void vdu_sys_layers_tilemap_mark_dirty(uint8_t tileLayerNum, uint8_t x, uint8_t y, uint8_t width, uint8_t height);
 		void vdu_sys_layers_tilemap_free(uint8_t tileMapNum);
 		void vdu_sys_layers_tilelayer_init(uint8_t tileLayerNum, uint8_t tileLayerSize, uint8_t tileSize);
 		void vdu_sys_layers_tilelayer_set_scroll(uint8_t tileLayerNum, uint8_t x, uint8_t y, uint8_t xOffset, uint8_t yOffset);
+		void vdu_sys_layers_tilelayer_set_property(uint8_t tileLayerNum, uint8_t property, uint8_t value);
 		void vdu_sys_layers_tilelayer_update_layerbuffer(uint8_t tileLayerNum);
 		void vdu_sys_layers_tilelayer_draw_layerbuffer(uint8_t tileLayerNum);
 		void vdu_sys_layers_tilelayer_draw(uint8_t tileLayerNum);
+		void vdu_sys_layers_tilelayer_composite();
 		void vdu_sys_layers_tilelayer_free(uint8_t tileLayerNum);
 		void writeTileToBuffer(uint8_t tileBankNum, uint8_t tileId, uint8_t tileCount, uint8_t xOffset, uint8_t tileBuffer[], uint8_t tileLayerWidth);
 		void writeTileToBufferFlipX(uint8_t tileBankNum, uint8_t tileId, uint8_t tileCount, uint8_t xOffset, uint8_t tileBuffer[], uint8_t tileLayerWidth);
 		void writeTileToBufferFlipY(uint8_t tileBankNum, uint8_t tileId, uint8_t tileCount, uint8_t xOffset, uint8_t tileBuffer[], uint8_t tileLayerWidth);
 		void writeTileToBufferFlipXY(uint8_t tileBankNum, uint8_t tileId, uint8_t tileCount, uint8_t xOffset, uint8_t tileBuffer[], uint8_t tileLayerWidth);
 
-		void writeTileToLayerBuffer(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth);
-		void writeTileToLayerBufferFlipX(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth);
-		void writeTileToLayerBufferFlipY(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth);
-		void writeTileToLayerBufferFlipXY(uint8_t tileBankNum, uint8_t tileId, uint8_t xPos, uint8_t xOffset, uint8_t yPos, uint8_t yOffset, uint8_t * tileBuffer, uint8_t tileLayerHeight, uint8_t tileLayerWidth);
+		void vdu_sys_layers_tilelayer_invalidate();
+		void renderTileLayerCell(uint8_t tileLayerNum, int column, int row);
+		uint8_t * getTileBankPtr(uint8_t tileBankNum);
+		void writeTileToLayerRing(uint8_t * tileBankPtr, uint8_t tileId, uint8_t tileFlip, uint8_t backgroundColour, uint8_t * dest, int destStride);
 
 		// Tile Bank variables
 
@@ -203,31 +225,22 @@ class VDUStreamProcessor {
 
 		// Tile Map variables
 
-		struct Tile {
-			uint8_t	id;
-			uint8_t attribute;
-		};
+		// Tile map entries are packed as the tile id in the low byte and the attribute in the high byte
 
-		struct Tile** tileMap0 = NULL;
+		static inline uint16_t packTile(uint8_t tileId, uint8_t tileAttribute) {
+			return tileId | (tileAttribute << 8);
+		}
 
 		struct TileMap {
 			uint8_t height;
 			uint8_t width;
 		};
 
-		TileMap tileMap0Properties;
-
 		// Tile Layer variables
 
 		Bitmap currentRow;
 		uint8_t currentRowDataBuffer[5184];		// Buffer big enough for 64 byte tiles * 81 columns (the largest supported size +1)
 
-		Bitmap tileLayer0Bitmap;					// Bitmap that points to the Layer 0 buffer
-
-		void * tileLayer0Buffer = NULL;				// The offscreen buffer for Layer 0
-
-		uint8_t * tileLayer0Ptr;					// A pointer to he tileLayer0Buffer
-
 		struct TileLayer {
 			uint8_t height;
 			uint8_t width;
@@ -237,13 +250,36 @@ class VDUStreamProcessor {
 			uint8_t yOffset;
 			uint8_t attribute;
 			uint8_t backgroundColour = 0;			// Default the background colour of the layer to 0 (transparent)
+			uint8_t transparentColour = 0;			// Pixel value treated as transparent when layers are composited
+			uint8_t priority = 0;					// Draw order when layers are composited, lowest first
+			uint8_t init = 0;						// Set when the layer has been initialised
+
+			uint16_t * tileMap = NULL;				// The tile map for this layer, row-major with a stride of the map width
+			TileMap tileMapProperties;
+
+			void * buffer = NULL;					// The offscreen buffer for the layer
+			uint8_t * bufferPtr;					// A pointer to the layer buffer
+			Bitmap bitmap;							// Bitmap that points to the layer buffer
+
+			void * ringBuffer = NULL;				// Rendered tiles, one more column and row than the layer, used as a 2D ring
+			uint8_t * ringPtr;						// A pointer to the ring buffer
+			uint8_t ringX = 0;						// Ring column and row holding the tile at the rendered map position
+			uint8_t ringY = 0;
+			uint8_t renderedXPos = 0;				// Tile map position the ring was rendered for
+			uint8_t renderedYPos = 0;
+			uint8_t renderedXOffset = 0;			// Offsets the layer buffer was copied from the ring with
+			uint8_t renderedYOffset = 0;
+			bool ringValid = false;					// Cleared when every tile in the ring must be rendered again
+			bool outputValid = false;				// Cleared when the layer buffer must be copied from the ring again
+			std::vector<uint16_t> dirtyTiles;		// Ring cells changed in the tile map since they were rendered
 		};
 
-		TileLayer tileLayer0;
-		TileLayer tileLayer1;
-		TileLayer tileLayer2;
+		TileLayer tileLayers[TILE_LAYERS];
 
-		uint8_t tileLayer0init = 0;		
+		void * tileCompositeBuffer = NULL;			// The buffer all layers are composited into
+		int tileCompositeBufferSize = 0;
+		Bitmap tileCompositeBitmap;
+		bool tileCompositeValid = false;			// Cleared when the composite must be rebuilt from the layer buffers
 
 		// End: Tile Engine
 
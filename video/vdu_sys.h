@@ -256,6 +256,24 @@ void VDUStreamProcessor::vdu_sys_video() {
 				context->setAffineTransform(flags, bufferId);
 			}
 		}	break;
+		case VDP_SCREEN_READ: {			// VDU 23, 0, &97, format, x; y; width; height; [bufferId;]
+			auto format = readByte_t();	// Read back a region of the screen
+			if (format == -1) return;
+			auto x = readWord_t();
+			if (x == -1) return;
+			auto y = readWord_t();
+			if (y == -1) return;
+			auto width = readWord_t();
+			if (width == -1) return;
+			auto height = readWord_t();
+			if (height == -1) return;
+			int32_t bufferId = 65535;
+			if (format & SCREEN_READ_TO_BUFFER) {
+				bufferId = readWord_t();
+				if (bufferId == -1) return;
+			}
+			sendScreenRegion(format, x, y, width, height, bufferId);
+		}	break;
 		case VDP_CONTROLKEYS: {			// VDU 23, 0, &98, n
 			auto b = readByte_t();		// Set control keys,  0 = off, 1 = on (default)
 			if (b >= 0) {
@@ -483,6 +501,107 @@ void VDUStreamProcessor::sendScrPixelPacket() {
 	send_packet(PACKET_SCRPIXEL, sizeof packet, packet);
 }
 
+// VDU 23, 0, &97, format, x; y; width; height; [bufferId;]: Read back a region of the screen
+// format bits 0-1 select the data returned, in rows from top-left:
+//   0: logical colour (palette index) per pixel
+//   1: RGBA8888 per pixel
+//   2: RGBA2222 per pixel
+//   3: character per text cell, with x, y, width and height given in characters
+// Pixel coordinates are screen pixels, and pixels off screen read as zero
+// If format bit 7 is set the data replaces the contents of bufferId, so it can be used as a bitmap
+// otherwise it is sent to MOS in PACKET_SCREEN_READ packets, sized to fit MOS's packet buffer as echo packets are
+//
+void VDUStreamProcessor::sendScreenRegion(uint8_t format, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint16_t bufferId) {
+	auto type = format & SCREEN_READ_FORMAT_MASK;
+	uint8_t bytesPerItem = type == SCREEN_READ_RGBA8888 ? 4 : 1;
+	uint32_t size = (uint32_t) width * height * bytesPerItem;
+	if (size == 0) {
+		debug_log("sendScreenRegion: zero size region\n\r");
+		return;
+	}
+
+	uint8_t * output = nullptr;
+	uint32_t packetSize = getVDPVariable(TESTFLAG_VDPP_BUFFERSIZE);
+	if (packetSize == 0) {
+		packetSize = 16;
+	}
+	packetSize = std::min<uint32_t>(packetSize, 255);
+	std::vector<uint8_t> packet;
+	if (format & SCREEN_READ_TO_BUFFER) {
+		bufferClear(bufferId);
+		auto buffer = bufferCreate(bufferId, size);
+		if (!buffer) {
+			debug_log("sendScreenRegion: failed to create buffer %d\n\r", bufferId);
+			return;
+		}
+		output = buffer->getBuffer();
+	} else {
+		packet.reserve(packetSize);
+	}
+	auto sendPacket = [&]() {
+		bufferCallCallbacks(CALLBACK_SENDING_VDPP | PACKET_SCREEN_READ);
+		send_packet(PACKET_SCREEN_READ, packet.size(), packet.data());
+		packet.clear();
+	};
+	auto emit = [&](uint8_t b) {
+		if (output) {
+			*output++ = b;
+			return;
+		}
+		packet.push_back(b);
+		if (packet.size() == packetSize) {
+			sendPacket();
+		}
+	};
+
+	waitPlotCompletion();
+	if (type == SCREEN_READ_CHARS) {
+		for (uint16_t row = 0; row < height; row++) {
+			for (uint16_t col = 0; col < width; col++) {
+				// character coordinates past 255 are well off screen
+				bool onScreen = x + col < 256 && y + row < 256;
+				emit(onScreen ? context->getScreenChar(x + col, y + row) : 0);
+			}
+		}
+	} else {
+		// Read the on-screen part of each row directly from the screen
+		std::vector<RGB888, psram_allocator<RGB888>> pixels(width);
+		int16_t x2 = std::min<int>(x + width - 1, canvasW - 1);
+		RGB888 lastPixel = RGB888(0, 0, 0);
+		uint8_t lastIndex = getPaletteIndex(lastPixel);
+		for (uint16_t row = 0; row < height; row++) {
+			std::fill(pixels.begin(), pixels.end(), RGB888(0, 0, 0));
+			if (y + row < canvasH && x < canvasW) {
+				readScreenRow(x, x2, y + row, pixels.data());
+			}
+			for (auto &pixel : pixels) {
+				switch (type) {
+					case SCREEN_READ_LOGICAL: {
+						if (!(pixel == lastPixel)) {
+							lastPixel = pixel;
+							lastIndex = getPaletteIndex(pixel);
+						}
+						emit(lastIndex);
+					}	break;
+					case SCREEN_READ_RGBA8888: {
+						emit(pixel.R);
+						emit(pixel.G);
+						emit(pixel.B);
+						emit(0xFF);
+					}	break;
+					case SCREEN_READ_RGBA2222: {
+						RGB222 c = RGB222(pixel);
+						emit(c.R | c.G << 2 | c.B << 4 | 0xC0);
+					}	break;
+				}
+			}
+		}
+	}
+	if (!packet.empty()) {
+		sendPacket();
+	}
+}
+
 void VDUStreamProcessor::printBuffer(uint16_t bufferId) {
 	auto bufferIter = buffers.find(bufferId);
 	if (bufferIter == buffers.end()) {